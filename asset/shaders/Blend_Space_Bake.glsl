@@ -0,0 +1,32 @@
+// baked blend space weights, written by Blend_Space_2D::upload_bake; Blend_Space_Bake.comp probes it there
+// 3 texels per cell: (w0, w1, dw0/dx, dw1/dx), (dw0/dy, dw1/dy, exact, 0), (track0, track1, track2, triangle)
+
+uniform sampler2D blend_bake;
+uniform vec2 blend_bake_origin;
+uniform vec2 blend_bake_cell_size;
+uniform ivec2 blend_bake_resolution;
+
+// false outside the blend space. Cells crossing a triangle edge have no exact answer here, they
+// extend the plane of the triangle under their center, clamped and renormalized.
+bool blend_bake_lookup(vec2 p, out vec3 weight, out ivec3 tracks)
+{
+    ivec2 c = ivec2(floor((p - blend_bake_origin) / blend_bake_cell_size));
+    if (any(lessThan(c, ivec2(0))) || any(greaterThanEqual(c, blend_bake_resolution)))
+        return false;
+
+    vec4 plane_x = texelFetch(blend_bake, ivec2(3 * c.x, c.y), 0);
+    vec4 plane_y = texelFetch(blend_bake, ivec2(3 * c.x + 1, c.y), 0);
+    vec4 track = texelFetch(blend_bake, ivec2(3 * c.x + 2, c.y), 0);
+    if (track.w < 0.0)
+        return false;
+
+    vec2 d = p - (blend_bake_origin + (vec2(c) + 0.5) * blend_bake_cell_size);
+    vec2 w = plane_x.xy + plane_x.zw * d.x + plane_y.xy * d.y;
+    weight = vec3(w, 1.0 - w.x - w.y);
+    if (plane_y.z == 0.0) {
+        weight = max(weight, vec3(0.0));
+        weight /= max(weight.x + weight.y + weight.z, 1e-6);
+    }
+    tracks = ivec3(track.xyz);
+    return true;
+}
@@ -0,0 +1,50 @@
+#version 430
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 texcoord;
+
+// struct Boid and Boid_Data come from Boid_Layout.glsl
+
+layout(std430, binding = 0) readonly buffer BoidBuffer {
+    Boid_Data boids[];
+};
+
+// boids that survived Boid_Cull.comp, one per instance of the indirect draw
+layout(std430, binding = 5) readonly buffer VisibleIds {
+    int visible_ids[];
+};
+
+uniform bool culled;
+
+out vec3 o_position;
+out vec3 o_normal;
+out vec2 o_texcoord;
+
+out float weight;
+
+uniform mat4 viewProj;
+
+uniform float boid_scale;
+
+// rotation is stored as glm::quat, x y z w
+vec3 quat_rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    // one instance per boid, transform is built from the simulation buffer directly
+    int boid_id = culled ? visible_ids[gl_InstanceID] : gl_InstanceID;
+    Boid b = unpack_boid(boids[boid_id]);
+
+    vec3 world_position = b.position + quat_rotate(b.rotation, boid_scale * position);
+
+    o_position = world_position;
+    o_normal   = quat_rotate(b.rotation, normal);
+    o_texcoord = texcoord.xy;
+    weight = 0.0;
+
+    gl_Position = viewProj * vec4(world_position, 1.0);
+}
@@ -0,0 +1,75 @@
+// Boid storage shared by every flock shader, Flock inserts this file after the #version line.
+// The C++ side is Group_Animation::Boid (48 bytes) and Group_Animation::Compact_Boid (28 bytes),
+// both checked with static_assert in group-animation.hpp; change them together.
+
+struct Boid {
+    vec3 position;
+    vec4 rotation;
+    vec3 velocity;
+};
+
+#ifdef COMPACT_BOID
+
+// std430 stride 28: float3 position, half4 rotation (x y z w), half3 velocity with an unused high half
+struct Boid_Data {
+    float position[3];
+    uint rotation[2];
+    uint velocity[2];
+};
+
+vec3 boid_position(Boid_Data d)
+{
+    return vec3(d.position[0], d.position[1], d.position[2]);
+}
+
+vec3 boid_velocity(Boid_Data d)
+{
+    return vec3(unpackHalf2x16(d.velocity[0]), unpackHalf2x16(d.velocity[1]).x);
+}
+
+Boid unpack_boid(Boid_Data d)
+{
+    // renormalized so half precision rounding does not build up over steps
+    vec4 rotation = vec4(unpackHalf2x16(d.rotation[0]), unpackHalf2x16(d.rotation[1]));
+    return Boid(boid_position(d), normalize(rotation), boid_velocity(d));
+}
+
+Boid_Data pack_boid(Boid b)
+{
+    Boid_Data d;
+    d.position[0] = b.position.x;
+    d.position[1] = b.position.y;
+    d.position[2] = b.position.z;
+    d.rotation[0] = packHalf2x16(b.rotation.xy);
+    d.rotation[1] = packHalf2x16(b.rotation.zw);
+    d.velocity[0] = packHalf2x16(b.velocity.xy);
+    d.velocity[1] = packHalf2x16(vec2(b.velocity.z, 0.0));
+    return d;
+}
+
+#else
+
+// std430 stride 48: vec3 members are 16 byte aligned, the C++ side stores them as vec4
+#define Boid_Data Boid
+
+vec3 boid_position(Boid_Data d)
+{
+    return d.position;
+}
+
+vec3 boid_velocity(Boid_Data d)
+{
+    return d.velocity;
+}
+
+Boid unpack_boid(Boid_Data d)
+{
+    return d;
+}
+
+Boid_Data pack_boid(Boid b)
+{
+    return b;
+}
+
+#endif
@@ -19,14 +19,14 @@ uniform sampler2D bone_current_pose;
 
 uniform int blend_anim_num;
 
-uniform int bone_id;
-
 uniform float gizmo_scale;
 uniform vec4 gizmo_color;
 uniform int show_bone_weight_id;
 
 void main()
 {
+    // one instance per bone, drawn with a single glDrawElementsInstanced
+    int bone_id = gl_InstanceID;
     int bone_offset = bone_id * 4;
 
     // vec4 ma = texelFetch(bone_bind_pose, ivec2((bone_offset    ) % 1024, (bone_offset    ) / 1024), 0);
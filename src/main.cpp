@@ -1,6 +1,9 @@
 #include "render/mesh.hpp"
 #include "render/render.hpp"
 #include "render/animation.hpp"
+#include "render/delaunay.hpp"
+#include "render/blend-space.hpp"
+#include "render/anim-graph.hpp"
 #include "render/group-animation.hpp"
 #include <stdio.h>
 #include <assert.h>
@@ -27,14 +30,27 @@ int main()
     // "#define MAX_bone_id_and_weight_LEN " + std::format("{:d}\n", human_with_skeleton.uniform_mesh.bone_id_and_weight.size()
     shader.compile();
     shader.apply();
-    shader.setUniform1i("bone_id_and_weight", 0);
-    shader.setUniform1i("bone_bind_pose", 1);
+    shader.set(shader.uniform<int>("bone_id_and_weight"), 0);
+    shader.set(shader.uniform<int>("bone_bind_pose"), 1);
+    // resolved once after link, the frame loop sets them without name lookups
+    auto shader_world = shader.uniform<glm::mat4>("world");
+    auto shader_view_proj = shader.uniform<glm::mat4>("viewProj");
+    auto shader_cam_pos = shader.uniform<glm::vec3>("cam_pos");
+    auto shader_import_animation = shader.uniform<bool>("import_animation");
+    auto shader_bone_current_pose = shader.uniform<int>("bone_current_pose");
+    auto shader_show_bone_weight_id = shader.uniform<int>("show_bone_weight_id");
 
     render::Shader gizmo_shader {
         {{GL_VERTEX_SHADER, "asset/shaders/Gizmo.vert"}, {GL_FRAGMENT_SHADER, "asset/shaders/Gizmo.frag"},}
     };
     gizmo_shader.compile();
     gizmo_shader.apply();
+    auto gizmo_world = gizmo_shader.uniform<glm::mat4>("world");
+    auto gizmo_view_proj = gizmo_shader.uniform<glm::mat4>("viewProj");
+    auto gizmo_bone_current_pose = gizmo_shader.uniform<int>("bone_current_pose");
+    auto gizmo_color = gizmo_shader.uniform<glm::vec4>("gizmo_color");
+    auto gizmo_scale = gizmo_shader.uniform<float>("gizmo_scale");
+    auto gizmo_show_bone_weight_id = gizmo_shader.uniform<int>("show_bone_weight_id");
 
     assimp_model::Model gizmo_model{};
     gizmo_model.load_with_config("asset/gizmo_config.json");
@@ -69,10 +85,58 @@ int main()
 
     Blendspace2D::Blend_Space_2D blend_space{};
     blend_space.init(human_with_skeleton, "asset/blend-space.json");
+    Blendspace::Blend_Space_1D speed_blend_space{};
+    speed_blend_space.init(human_with_skeleton, "asset/blend-space-1d.json");
+    auto blend_dimension{2};
+    auto blend_speed{0.0f};
+
+    // blend_dimension 0: switches between the 2d blend space with the 1d speed blend, an upper body
+    // overlay and an upper body additive layered on top, and the speed blend alone, evaluated lazily
+    Anim_Graph::Graph anim_graph{};
+    anim_graph.init(human_with_skeleton);
+    auto graph_layered = std::make_unique<Anim_Graph::Layered_Node>();
+    auto graph_direction = Anim_Graph::load_blend<2>("asset/blend-space.json");
+    auto graph_speed = Anim_Graph::load_blend<1>("asset/blend-space-1d.json");
+    auto graph_speed_only = Anim_Graph::load_blend<1>("asset/blend-space-1d.json");
+    auto& graph_direction_node = *graph_direction;
+    auto& graph_speed_node = *graph_speed;
+    auto& graph_speed_only_node = *graph_speed_only;
+    auto upper_body = Anim_Graph::Bone_Mask{};
+    upper_body.add_subtree(human_with_skeleton, "spine_02");
+    auto additive_track = std::find_if(human_with_skeleton.tracks.begin(), human_with_skeleton.tracks.end(), [](auto& track) { return track.additive; });
+    graph_layered->base = std::move(graph_direction);
+    graph_layered->layers.push_back({std::move(graph_speed), 0.0f});
+    graph_layered->layers.push_back({std::make_unique<Anim_Graph::Clip_Node>(human_with_skeleton.play_anim_track), 0.0f, upper_body});
+    if (additive_track != human_with_skeleton.tracks.end())
+        graph_layered->layers.push_back({std::make_unique<Anim_Graph::Clip_Node>(int(additive_track - human_with_skeleton.tracks.begin())), 0.0f, upper_body, true});
+    auto& graph_speed_layer = graph_layered->layers[0];
+    auto& graph_upper_body_layer = graph_layered->layers[1];
+    auto graph_additive_layer = graph_layered->layers.size() > 2 ? &graph_layered->layers[2] : nullptr;
+    auto graph_root = std::make_unique<Anim_Graph::Switch_Node>();
+    auto& graph_switch = *graph_root;
+    graph_root->states.emplace_back(std::move(graph_layered));
+    graph_root->states.emplace_back(std::move(graph_speed_only));
+    anim_graph.root = std::move(graph_root);
+    auto graph_state{0};
+    auto graph_inertialize{true};
+    auto delaunay_bench = std::vector<Blendspace2D::Delaunay_Sample>{};
+    auto crowd_bench = Blendspace2D::Batch_Bench{};
+    auto bake_resolution{64};
+    auto bake_accuracy = Blendspace2D::Bake_Accuracy{};
 
     Group_Animation::Flock flock{};
     flock.init("asset/boid_config.json", "asset/flock_config.json");
 
+    auto flock_bench_brute = std::vector<Group_Animation::Bench_Sample>{};
+    auto flock_bench_grid = std::vector<Group_Animation::Bench_Sample>{};
+    auto flock_bench_simd_brute = std::vector<Group_Animation::Bench_Sample>{};
+    auto flock_bench_simd_grid = std::vector<Group_Animation::Bench_Sample>{};
+    auto flock_bench_lists = std::vector<Group_Animation::Bench_Sample>{};
+    auto flock_bench_simd_lists = std::vector<Group_Animation::Bench_Sample>{};
+    auto flock_gpu_error{-1.0f};
+    auto show_flock_checksum{false};
+    auto flock_deterministic{-1};
+
     auto display = [&]()
     {
         auto view_matrix  = glm::lookAt(render::window::cam_position, render::window::cam_look_at, render::window::cam_up);
@@ -82,22 +146,22 @@ int main()
         world_matrix = glm::scale(world_matrix, glm::vec3(human_with_skeleton.scale));
 
         shader.apply();
-        shader.setUniformMatrix4fv("world", world_matrix);
-        shader.setUniformMatrix4fv("viewProj", projection_matrix * view_matrix);
-        shader.setUniform3fv("cam_pos", render::window::cam_position);
+        shader.set(shader_world, world_matrix);
+        shader.set(shader_view_proj, projection_matrix * view_matrix);
+        shader.set(shader_cam_pos, render::window::cam_position);
         if (show_flock_anim) {
             flock.update(delta_frame_time);
-            flock.draw(shader); 
+            flock.draw(projection_matrix * view_matrix, render::window::cam_position);
         }
         
 
         shader.apply();
-        shader.setUniformMatrix4fv("world", world_matrix);
-        shader.setUniformMatrix4fv("viewProj", projection_matrix * view_matrix);
+        shader.set(shader_world, world_matrix);
+        shader.set(shader_view_proj, projection_matrix * view_matrix);
 
         gizmo_shader.apply();
-        gizmo_shader.setUniformMatrix4fv("world", world_matrix);
-        gizmo_shader.setUniformMatrix4fv("viewProj", projection_matrix * view_matrix);
+        gizmo_shader.set(gizmo_world, world_matrix);
+        gizmo_shader.set(gizmo_view_proj, projection_matrix * view_matrix);
         auto current_clock = std::chrono::high_resolution_clock().now();
 
         auto update_time_and_logic = [&]() -> void {
@@ -135,20 +199,29 @@ int main()
         update_time_and_logic();
 
         auto update_animation = [&]() -> void {
-            blend_space.update(human_with_skeleton, glm::vec2(slider2d_pos.x, slider2d_pos.y), weight_left_frame, weight_right_frame);
+            if (blend_dimension == 0) {
+                graph_direction_node.parameter = glm::vec2(slider2d_pos.x, slider2d_pos.y);
+                graph_speed_node.parameter = Blendspace::Point<1>{blend_speed};
+                graph_speed_only_node.parameter = Blendspace::Point<1>{blend_speed};
+                anim_graph.evaluate(delta_frame_time * human_with_skeleton.speed);
+            } else if (blend_dimension == 1)
+                speed_blend_space.update(human_with_skeleton, Blendspace::Point<1>{blend_speed}, weight_left_frame, weight_right_frame);
+            else
+                blend_space.update(human_with_skeleton, glm::vec2(slider2d_pos.x, slider2d_pos.y), weight_left_frame, weight_right_frame);
         };
 
         update_animation();
 
         shader.apply();
-        shader.setUniform1b("import_animation", human_with_skeleton.import_animation);
-        shader.setUniform1i("bone_current_pose", 2);
-        shader.setUniform1i("show_bone_weight_id", human_with_skeleton.show_bone_weight_id);
+        shader.set(shader_import_animation, human_with_skeleton.import_animation);
+        shader.set(shader_bone_current_pose, 2);
+        shader.set(shader_show_bone_weight_id, human_with_skeleton.show_bone_weight_id);
 
         gizmo_shader.apply();
-        gizmo_shader.setUniform1i("bone_current_pose", 2);
-        gizmo_shader.setUniform4fv("gizmo_color", bone_gizmo_color);
-        gizmo_shader.setUniform1f("gizmo_scale", gizmo_model.scale);
+        gizmo_shader.set(gizmo_bone_current_pose, 2);
+        gizmo_shader.set(gizmo_color, bone_gizmo_color);
+        gizmo_shader.set(gizmo_scale, gizmo_model.scale);
+        gizmo_shader.set(gizmo_show_bone_weight_id, human_with_skeleton.show_bone_weight_id);
 
         if (show_skeleton_anim) {
             shader.apply();
@@ -161,11 +234,7 @@ int main()
             glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
             glEnable(GL_BLEND);
             gizmo_shader.apply();
-            for (auto bone_gz_id = 0; bone_gz_id < human_with_skeleton.bones.size(); bone_gz_id++) {
-                gizmo_shader.setUniform1i("bone_id", bone_gz_id);
-                gizmo_shader.setUniform1i("show_bone_weight_id", human_with_skeleton.show_bone_weight_id);
-                gizmo_model.draw();
-            }
+            gizmo_model.draw_instanced(human_with_skeleton.bones.size());
             glDisable(GL_BLEND);
             glEnable(GL_DEPTH_TEST);
         }
@@ -203,6 +272,38 @@ int main()
                         ImGui::Text("Disable bone weight visualize");
                     ImGui::SliderInt("bone", &human_with_skeleton.show_bone_weight_id, -1, human_with_skeleton.bones.size() - 1);
 
+                    ImGui::RadioButton("2d blend space", &blend_dimension, 2);
+                    ImGui::SameLine();
+                    ImGui::RadioButton("1d speed blend", &blend_dimension, 1);
+                    ImGui::SameLine();
+                    ImGui::RadioButton("anim graph", &blend_dimension, 0);
+                    if (blend_dimension == 1) {
+                        ImGui::SliderFloat("speed", &blend_speed, 0.0f, 1.0f);
+                        for (auto k = 0; k < speed_blend_space.current.weights.size(); k++)
+                            ImGui::Text("anim%d - %.2f", speed_blend_space.current.track_ids[k], speed_blend_space.current.weights[k]);
+                    }
+                    if (blend_dimension == 0) {
+                        ImGui::SliderFloat("speed", &blend_speed, 0.0f, 1.0f);
+                        ImGui::SliderFloat("speed layer", &graph_speed_layer.weight, 0.0f, 1.0f);
+                        ImGui::SliderFloat(std::format("upper body ({:d} bones)", graph_upper_body_layer.mask.bones.size()).c_str(), &graph_upper_body_layer.weight, 0.0f, 1.0f);
+                        if (graph_additive_layer)
+                            ImGui::SliderFloat("upper body additive", &graph_additive_layer->weight, 0.0f, 1.0f);
+                        ImGui::Checkbox("inertialize", &graph_inertialize);
+                        ImGui::SameLine();
+                        ImGui::SliderFloat("blend time", &graph_switch.blend_time, 0.05f, 1.0f);
+                        graph_switch.mode = graph_inertialize ? Anim_Graph::Transition_Mode::inertialize : Anim_Graph::Transition_Mode::crossfade;
+                        ImGui::RadioButton("layered", &graph_state, 0);
+                        ImGui::SameLine();
+                        ImGui::RadioButton("speed only", &graph_state, 1);
+                        graph_switch.request(graph_state);
+                        auto& cost = graph_switch.last_cost;
+                        if (cost.frames > 0)
+                            ImGui::Text("last transition %d frames, %.1f clips / %.1f us per frame", cost.frames, float(cost.sampled_clips) / cost.frames, cost.seconds * 1e6f / cost.frames);
+                        auto& context = anim_graph.context;
+                        ImGui::Text("nodes %d / %d, clips sampled %d", context.visited_nodes, anim_graph.root->node_num(), context.sampled_clips);
+                        ImGui::Text("pooled poses %d, peak in use %d", int(context.pool.poses.size()), context.pool.peak_in_use);
+                    }
+
                     // ImGui::Text("Blend Space");
                     ImGui::Checkbox("show blend space", &show_blend_space);
                     // ImGui::InvisibleButton("layout", ImVec2(100, 100), 0);
@@ -260,10 +361,41 @@ int main()
                         ImGui::Text("blend position x %.2f - y %.2f\n", blend_space.position.x, blend_space.position.y);
                         ImGui::Text(
                             "blend weight\nanim%d - %.2f\nanim%d - %.2f\nanim%d - %.2f\n",
-                            blend_space.track_ids[0], blend_space.blend_weight[0],
-                            blend_space.track_ids[1], blend_space.blend_weight[1],
-                            blend_space.track_ids[2], blend_space.blend_weight[2]
+                            blend_space.current.track_ids[0], blend_space.current.weights[0],
+                            blend_space.current.track_ids[1], blend_space.current.weights[1],
+                            blend_space.current.track_ids[2], blend_space.current.weights[2]
                         );
+                        ImGui::SliderInt("bake resolution", &bake_resolution, 4, 512);
+                        if (ImGui::Button("bake weights")) {
+                            blend_space.bake_weights({bake_resolution, bake_resolution});
+                            blend_space.upload_bake();
+                            bake_accuracy = blend_space.compare_bake(100000);
+                        }
+                        if (!blend_space.bake.cells.empty()) {
+                            ImGui::SameLine();
+                            ImGui::Checkbox("use bake", &blend_space.use_bake);
+                            ImGui::Text("%.1f%% exact cells, error max %.2e mean %.2e", 100.0f * bake_accuracy.exact_fraction, bake_accuracy.max_error, bake_accuracy.mean_error);
+                            ImGui::Text("center only: error max %.3f mean %.4f, %.1f%% other triangle", bake_accuracy.center_max_error, bake_accuracy.center_mean_error, 100.0f * bake_accuracy.center_mismatch);
+                            ImGui::Text("baked %.1f ns, analytic %.1f ns per query", bake_accuracy.baked_ns, bake_accuracy.analytic_ns);
+                        }
+                        if (ImGui::Button("benchmark crowd blend"))
+                            crowd_bench = blend_space.benchmark_batch(10000);
+                        if (crowd_bench.agent_num > 0)
+                            ImGui::Text(
+                                "%d agents, agents per ms\nlinear scan %.0f\nlocate %.0f\nbatch %.0f\nbatch simd %.0f",
+                                crowd_bench.agent_num, crowd_bench.linear_scan, crowd_bench.locate, crowd_bench.batch, crowd_bench.batch_simd
+                            );
+                        if (ImGui::Button("benchmark delaunay")) {
+                            delaunay_bench = Blendspace2D::benchmark_delaunay({10, 100, 1000, 10000, 100000});
+                            // axes in different units, e.g. speed in cm/s against an angle
+                            auto anisotropic = Blendspace2D::benchmark_delaunay({6, 100, 10000}, 500.0f);
+                            delaunay_bench.insert(delaunay_bench.end(), anisotropic.begin(), anisotropic.end());
+                        }
+                        for (auto& sample: delaunay_bench)
+                            ImGui::Text(
+                                "%d nodes, aspect %.0f, %d triangles: %.2f ms, %d dropped, %.3f of the hull",
+                                sample.node_num, sample.aspect, sample.triangle_num, sample.build_ms, sample.dropped_nodes, sample.hull_coverage
+                            );
                     }
 
                     
@@ -279,13 +411,143 @@ int main()
                 
                 ImGui::Checkbox("show flock animation", &show_flock_anim);
                 if (show_flock_anim) {
-                    ImGui::Checkbox("enable GPU compute", &flock.enable_gpu);
-                    ImGui::InputInt("boid_num", &flock.boid_num);
+                    ImGui::Checkbox("auto backend", &flock.auto_backend);
+                    if (ImGui::BeginCombo("backend", flock.backends[flock.backend]->name())) {
+                        for (auto b = 0; b < flock.backends.size(); b++) {
+                            if (ImGui::Selectable(flock.backends[b]->name(), b == flock.backend)) {
+                                flock.backend = b;
+                                flock.auto_backend = false;
+                            }
+                        }
+                        ImGui::EndCombo();
+                    }
+                    if (ImGui::TreeNode("calibration")) {
+                        auto& calibration = flock.calibration;
+                        if (calibration.sizes.empty())
+                            ImGui::Text("not calibrated yet, auto backend runs %s", flock.backends[flock.default_backend]->name());
+                        for (auto k = 0; k < calibration.sizes.size(); k++) {
+                            ImGui::Text("%d boids: %s", calibration.sizes[k], flock.backends[calibration.fastest(k)]->name());
+                            for (auto b = 0; b < flock.backends.size(); b++) {
+                                if (calibration.steps_per_second[b][k] > 0.0f)
+                                    ImGui::BulletText("%s %.1f steps/s", flock.backends[b]->name(), calibration.steps_per_second[b][k]);
+                            }
+                        }
+                        for (auto& crossover: calibration.crossovers)
+                            ImGui::Text("%s -> %s from %d boids", flock.backends[crossover.from]->name(), flock.backends[crossover.to]->name(), crossover.boid_num);
+                        // blocks for a few seconds
+                        if (ImGui::Button(calibration.sizes.empty() ? "calibrate" : "recalibrate"))
+                            flock.calibrate({1000, 4000, 16000, 64000}, 0.25f);
+                        ImGui::TreePop();
+                    }
+                    ImGui::Checkbox("frustum cull", &flock.frustum_cull);
+                    if (flock.frustum_cull && flock.culler.visible_num >= 0) {
+                        ImGui::SameLine();
+                        ImGui::Text("%d / %d visible", flock.culler.visible_num, int(flock.boids.size()));
+                    }
+                    if (flock.uses_gpu()) {
+                        auto compact = flock.compact_boids;
+                        if (ImGui::Checkbox("compact gpu boids", &compact))
+                            flock.set_compact(compact);
+                        if (flock.step_timer.average_ms >= 0.0f)
+                            ImGui::Text("gpu step %.3f ms, %d bytes per boid", flock.step_timer.average_ms, flock.boid_stride());
+                        ImGui::Text("steering group size %d", flock.group_size);
+                        ImGui::SameLine();
+                        if (ImGui::Button("tune"))
+                            flock.tune_dispatch = true;
+                        ImGui::Checkbox("async readback", &flock.enable_readback);
+                        if (flock.enable_readback) {
+                            auto snapshot = flock.latest_snapshot();
+                            if (snapshot.boids != nullptr)
+                                ImGui::Text("snapshot step %llu, %llu steps behind", (unsigned long long)snapshot.step, (unsigned long long)(flock.step_id - snapshot.step));
+                            else
+                                ImGui::Text("no snapshot yet");
+                        }
+                    }
+                    if (ImGui::InputInt("boid_num", &flock.boid_num, 100, 10000))
+                        flock.boid_num = glm::clamp(flock.boid_num, 0, Group_Animation::Flock::max_boid_num);
                     ImGui::DragFloat("min_distance", &flock.min_distance, 0.01f, 0.0f, 1.0f);
                     ImGui::DragFloat("visual_range", &flock.visual_range, 0.01f, 0.0f, 1.0f);
                     ImGui::DragFloat("avoid_factor", &flock.avoid_factor, 0.01f, 0.0f, 0.1f);
                     ImGui::DragFloat("center_factor", &flock.center_factor, 0.01f, 0.0f, 0.1f);
                     ImGui::DragFloat("align_factor", &flock.align_factor, 0.01f, 0.0f, 0.1f);
+
+                    ImGui::Checkbox("spatial grid", &flock.use_grid);
+                    if (!flock.uses_gpu()) {
+                        ImGui::Text("cpu workers %d", flock.pool().thread_num());
+                        ImGui::Checkbox("neighbor lists", &flock.use_neighbor_lists);
+                        if (flock.use_neighbor_lists) {
+                            ImGui::DragFloat("skin", &flock.skin, 0.005f, 0.0f, 0.5f);
+                            ImGui::SliderInt("rebuild interval", &flock.rebuild_interval, 1, 60);
+                            auto& lists = flock.neighbor_lists;
+                            ImGui::Text("rebuilt on %.0f%% of steps, %.1f neighbors per boid", 100.0f * lists.rebuild_rate(), lists.slots.size() / float(glm::max(int(lists.order.size()), 1)));
+                        }
+                        if (flock.cpu_step_ms >= 0.0f)
+                            ImGui::Text("cpu step %.3f ms", flock.cpu_step_ms);
+                        ImGui::Checkbox("time slice", &flock.time_slice);
+                        if (flock.time_slice) {
+                            ImGui::DragFloat("frame budget ms", &flock.frame_budget_ms, 0.1f, 0.1f, 33.0f);
+                            ImGui::Text("%d of %d boids steered per step", flock.slice_count, int(flock.boids.size()));
+                            ImGui::Text("each boid steered every %.1f steps, %.1f Hz", flock.steer_interval, ImGui::GetIO().Framerate / flock.steer_interval);
+                        }
+                    }
+                    if (flock.uses_gpu()) {
+                        if (ImGui::Button("validate gpu step"))
+                            flock_gpu_error = flock.validate_gpu_step(1.0f / 60.0f);
+                        if (flock_gpu_error >= 0.0f)
+                            ImGui::Text("gpu vs cpu grid max position error %g", flock_gpu_error);
+                    }
+                    ImGui::Checkbox("show checksum", &show_flock_checksum);
+                    if (show_flock_checksum) {
+                        auto snapshot = flock.latest_snapshot();
+                        if (snapshot.boids != nullptr) {
+                            auto sum = Group_Animation::checksum(snapshot);
+                            ImGui::Text("step %llu hash %016llx", (unsigned long long)sum.step, (unsigned long long)sum.hash);
+                            ImGui::Text("position sum %.6f %.6f %.6f", sum.position_sum.x, sum.position_sum.y, sum.position_sum.z);
+                        } else {
+                            ImGui::Text("enable async readback for gpu checksums");
+                        }
+                    }
+                    if (ImGui::Button("check cpu determinism")) {
+                        // same seeded run on one thread and on the shared pool, hashes must match bit for bit
+                        auto single_thread = Parallel::Worker_Pool{1};
+                        auto reference = flock.replay(flock.boid_num, 30, single_thread);
+                        auto threaded = flock.replay(flock.boid_num, 30, Parallel::Worker_Pool::shared());
+                        flock_deterministic = reference.back().hash == threaded.back().hash ? 1 : 0;
+                    }
+                    if (flock_deterministic >= 0)
+                        ImGui::Text(flock_deterministic == 1 ? "1 thread and %d threads match" : "1 thread and %d threads differ", Parallel::Worker_Pool::shared().thread_num());
+                    if (ImGui::Button("benchmark cpu step")) {
+                        auto sizes = std::vector<int>{1000, 2000, 5000, 10000, 20000, 50000, 100000};
+                        flock_bench_brute = flock.benchmark_cpu(sizes, false);
+                        flock_bench_grid = flock.benchmark_cpu(sizes, true);
+                        flock_bench_simd_brute = flock.benchmark_cpu(sizes, false, Group_Animation::Flock_Kernel::simd);
+                        flock_bench_simd_grid = flock.benchmark_cpu(sizes, true, Group_Animation::Flock_Kernel::simd);
+                        flock_bench_lists = flock.benchmark_cpu(sizes, true, Group_Animation::Flock_Kernel::scalar, true);
+                        flock_bench_simd_lists = flock.benchmark_cpu(sizes, true, Group_Animation::Flock_Kernel::simd, true);
+                    }
+                    auto plot_bench = [&](const char* label, std::vector<Group_Animation::Bench_Sample>& samples) -> void {
+                        if (samples.empty())
+                            return;
+                        auto values = std::vector<float>{};
+                        for (auto& sample: samples) {
+                            values.emplace_back(sample.steps_per_second);
+                            ImGui::Text("%s %d boids: %.1f steps/s", label, sample.boid_num, sample.steps_per_second);
+                        }
+                        ImGui::PlotLines(label, values.data(), values.size(), 0, "steps/s", 0.0f, FLT_MAX, ImVec2(0, 60));
+                    };
+                    plot_bench("brute force", flock_bench_brute);
+                    plot_bench("grid", flock_bench_grid);
+                    plot_bench("simd brute force", flock_bench_simd_brute);
+                    plot_bench("simd grid", flock_bench_simd_grid);
+                    plot_bench("neighbor lists", flock_bench_lists);
+                    plot_bench("simd neighbor lists", flock_bench_simd_lists);
+                    auto show_speedup = [&](const char* label, std::vector<Group_Animation::Bench_Sample>& lists, std::vector<Group_Animation::Bench_Sample>& grid) -> void {
+                        for (auto i = 0; i < glm::min(lists.size(), grid.size()); i++) {
+                            ImGui::Text("%s %d boids: lists x%.2f over grid", label, lists[i].boid_num, lists[i].steps_per_second / grid[i].steps_per_second);
+                        }
+                    };
+                    show_speedup("scalar", flock_bench_lists, flock_bench_grid);
+                    show_speedup("simd", flock_bench_simd_lists, flock_bench_simd_grid);
                 }
                 ImGui::End();
                 ImGui::Render();
@@ -311,6 +573,8 @@ int main()
     run();
 
     // Cleanup
+    blend_space.release_bake();
+    flock.release();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
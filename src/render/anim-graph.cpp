@@ -0,0 +1,476 @@
+#include "anim-graph.hpp"
+#include "render/cmake-source-dir.hpp"
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+
+namespace Anim_Graph
+{
+    auto Pose_Pool::acquire() -> int
+    {
+        in_use++;
+        peak_in_use = std::max(peak_in_use, in_use);
+        if (!free_ids.empty()) {
+            auto id = free_ids.back();
+            free_ids.pop_back();
+            return id;
+        }
+        poses.emplace_back(bone_num);
+        return int(poses.size()) - 1;
+    }
+
+    auto Bone_Mask::add_subtree(const assimp_model::Model& model, const std::string& root_name) -> void
+    {
+        auto root = model.bone_name_to_id.find(root_name);
+        if (root == model.bone_name_to_id.end()) {
+            std::cout << std::format("bone mask root {:s} not in skeleton\n", root_name);
+            return;
+        }
+
+        auto stack = std::vector<int>{int(root->second)};
+        while (!stack.empty()) {
+            auto bone = stack.back();
+            stack.pop_back();
+            bones.emplace_back(bone);
+            for (auto child: model.bones[bone].child_id)
+                stack.emplace_back(child);
+        }
+        std::sort(bones.begin(), bones.end());
+        bones.erase(std::unique(bones.begin(), bones.end()), bones.end());
+    }
+
+    auto accumulate(const Context& context, Pose& acc, const Pose& pose, float weight, float& weight_sum) -> void
+    {
+        if (weight_sum <= 0.0f) {
+            for_each_bone(context, acc.size(), [&](int i) {
+                acc[i] = pose[i];
+            });
+            weight_sum = weight;
+            return;
+        }
+        weight_sum += weight;
+        auto t = weight / weight_sum;
+        for_each_bone(context, acc.size(), [&](int i) {
+            acc[i].position = glm::mix(acc[i].position, pose[i].position, t);
+            acc[i].rotation = glm::slerp(acc[i].rotation, pose[i].rotation, t);
+            acc[i].scale = glm::mix(acc[i].scale, pose[i].scale, t);
+        });
+    }
+
+    // out = out + alpha * delta, delta from an additive track
+    static auto apply_additive(const Context& context, Pose& out, const Pose& delta, float alpha) -> void
+    {
+        for_each_bone(context, out.size(), [&](int i) {
+            out[i].position += alpha * delta[i].position;
+            out[i].rotation = glm::slerp(glm::identity<glm::quat>(), delta[i].rotation, alpha) * out[i].rotation;
+            out[i].scale *= glm::mix(glm::vec3(1.0f), delta[i].scale, alpha);
+        });
+    }
+
+    // bones without keys get the identity transform, which is also no change for an additive track
+    static auto sample_track(const Context& context, const assimp_model::Track& track, float frame, Pose& out) -> void
+    {
+        auto right_weight = frame - float(int(frame));
+        for_each_bone(context, out.size(), [&](int i) {
+            auto& channel = track.channels[i];
+            auto key_num = int(channel.rotations.size());
+            if (key_num == 0) {
+                out[i] = {glm::identity<glm::quat>(), glm::vec3(0.0f), glm::vec3(1.0f)};
+                return;
+            }
+            auto left = glm::clamp(int(frame), 0, key_num - 1);
+            auto right = glm::min(left + 1, key_num - 1);
+            out[i].position = glm::mix(channel.positions[left], channel.positions[right], right_weight);
+            out[i].rotation = glm::slerp(channel.rotations[left], channel.rotations[right], right_weight);
+            out[i].scale = glm::mix(channel.scales[left], channel.scales[right], right_weight);
+        });
+    }
+
+    auto Clip_Node::evaluate(Context& context, float, Pose& out) -> void
+    {
+        context.visited_nodes++;
+        context.sampled_clips++;
+
+        auto& track = context.model->tracks[track_id];
+        // same loop length as Blendspace::advance_frames, the last key wraps to the first
+        auto frame_num = glm::max(track.duration - 1.0f, 1.0f);
+        advance(context);
+        auto frame = glm::mod(time * track.frame_per_second, frame_num);
+        sample_track(context, track, frame, out);
+    }
+
+    template <int D>
+    auto Blend_Node<D>::add(const Blendspace::Point<D>& point, std::unique_ptr<Node> child) -> Node&
+    {
+        points.emplace_back(point);
+        return *children.emplace_back(std::move(child));
+    }
+
+    template <int D>
+    auto Blend_Node<D>::build() -> void
+    {
+        auto child_ids = std::vector<int>(children.size());
+        std::iota(child_ids.begin(), child_ids.end(), 0);
+        space.build(points, child_ids);
+        weights = space.current;
+        last_simplex = -1;
+    }
+
+    template <int D>
+    auto Blend_Node<D>::evaluate(Context& context, float weight, Pose& out) -> void
+    {
+        context.visited_nodes++;
+
+        auto s = space.locate(parameter, last_simplex);
+        if (s >= 0) {
+            space.weigh(parameter, s, weights);
+            last_simplex = s;
+        }
+
+        // only corners of the simplex under the parameter are sampled, every other child just advances;
+        // the heaviest corner always runs so a faint blend node still writes a pose
+        auto heaviest = int(std::max_element(weights.weights.begin(), weights.weights.end()) - weights.weights.begin());
+        auto sampled = std::array<int, D + 1>{};
+        sampled.fill(-1);
+        auto child_pose = Pooled_Pose(context.pool);
+        auto weight_sum = 0.0f;
+        for (auto k = 0; k < weights.weights.size(); k++) {
+            auto w = weights.weights[k];
+            if (w * weight < min_weight && k != heaviest)
+                continue;
+            sampled[k] = weights.track_ids[k];
+            children[sampled[k]]->evaluate(context, w * weight, child_pose.get());
+            accumulate(context, out, child_pose.get(), w, weight_sum);
+        }
+        for (auto c = 0; c < children.size(); c++) {
+            if (std::find(sampled.begin(), sampled.end(), c) == sampled.end())
+                children[c]->advance(context);
+        }
+    }
+
+    template <int D>
+    auto Blend_Node<D>::advance(Context& context) -> void
+    {
+        for (auto& child: children)
+            child->advance(context);
+    }
+
+    template <int D>
+    auto Blend_Node<D>::node_num() const -> int
+    {
+        auto num = 1;
+        for (auto& child: children)
+            num += child->node_num();
+        return num;
+    }
+
+    template <int D>
+    auto load_blend(const std::string path) -> std::unique_ptr<Blend_Node<D>>
+    {
+        std::ifstream config_fs(ROOT_DIR + path);
+        auto config = nlohmann::json::parse(config_fs, nullptr, true, true);
+
+        constexpr const char* axes[] = {"x", "y"};
+        auto blend = std::make_unique<Blend_Node<D>>();
+        for (auto& node: config.find("node").value()) {
+            auto p = Blendspace::Point<D>{};
+            for (auto k = 0; k < D; k++)
+                p[k] = node.find(axes[k]).value();
+            blend->add(p, std::make_unique<Clip_Node>(node.find("anim_id").value()));
+        }
+        blend->build();
+        return blend;
+    }
+
+    template struct Blend_Node<1>;
+    template struct Blend_Node<2>;
+    template auto load_blend<1>(const std::string path) -> std::unique_ptr<Blend_Node<1>>;
+    template auto load_blend<2>(const std::string path) -> std::unique_ptr<Blend_Node<2>>;
+
+    auto Additive_Node::evaluate(Context& context, float weight, Pose& out) -> void
+    {
+        context.visited_nodes++;
+        base->evaluate(context, weight, out);
+        if (alpha * weight < min_weight) {
+            additive->advance(context);
+            return;
+        }
+
+        auto delta = Pooled_Pose(context.pool);
+        additive->evaluate(context, alpha * weight, delta.get());
+        apply_additive(context, out, delta.get(), alpha);
+    }
+
+    auto Additive_Node::advance(Context& context) -> void
+    {
+        base->advance(context);
+        additive->advance(context);
+    }
+
+    auto Additive_Node::node_num() const -> int
+    {
+        return 1 + base->node_num() + additive->node_num();
+    }
+
+    auto Layered_Node::evaluate(Context& context, float weight, Pose& out) -> void
+    {
+        context.visited_nodes++;
+
+        // only full body, non additive layers hide what is under them
+        auto hides = [](const Layer& layer) {
+            return !layer.additive && layer.mask.bones.empty();
+        };
+        // share of the final pose left to what lies under layer k once layers k.. are applied
+        auto share_under = [&](int k) {
+            auto share = weight;
+            for (auto m = k; m < layers.size(); m++) {
+                if (hides(layers[m]))
+                    share *= 1.0f - layers[m].weight;
+            }
+            return share;
+        };
+
+        // a full weight layer hides the base and every layer under it, none of them are sampled
+        auto written = false;
+        auto base_ran = share_under(0) >= min_weight;
+        if (base_ran) {
+            base->evaluate(context, share_under(0), out);
+            written = true;
+        }
+
+        auto layer_pose = Pooled_Pose(context.pool);
+        auto outer_bones = context.bones;
+        for (auto k = 0; k < layers.size(); k++) {
+            auto& layer = layers[k];
+            auto share = layer.weight * share_under(k + 1);
+            if (share < min_weight) {
+                layer.node->advance(context);
+                continue;
+            }
+
+            // the layer's subtree samples and blends its masked bones only
+            if (!layer.mask.bones.empty())
+                context.bones = &layer.mask.bones;
+            layer.node->evaluate(context, share, layer_pose.get());
+            auto& pose = layer_pose.get();
+            if (layer.additive) {
+                apply_additive(context, out, pose, layer.weight);
+            } else {
+                auto t = written ? layer.weight : 1.0f;
+                for_each_bone(context, out.size(), [&](int i) {
+                    out[i].position = glm::mix(out[i].position, pose[i].position, t);
+                    out[i].rotation = glm::slerp(out[i].rotation, pose[i].rotation, t);
+                    out[i].scale = glm::mix(out[i].scale, pose[i].scale, t);
+                });
+                written = true;
+            }
+            context.bones = outer_bones;
+        }
+        if (!written)
+            base->evaluate(context, weight, out);
+        else if (!base_ran)
+            base->advance(context);
+    }
+
+    auto Layered_Node::advance(Context& context) -> void
+    {
+        base->advance(context);
+        for (auto& layer: layers)
+            layer.node->advance(context);
+    }
+
+    auto Layered_Node::node_num() const -> int
+    {
+        auto num = 1 + base->node_num();
+        for (auto& layer: layers)
+            num += layer.node->node_num();
+        return num;
+    }
+
+    auto Offset_Decay::init(float offset, float velocity, float blend_time) -> void
+    {
+        x0 = offset;
+        duration = blend_time;
+        if (x0 < 1e-6f || duration <= 0.0f) {
+            x0 = v0 = a0 = a = b = c = 0.0f;
+            return;
+        }
+        // moving away from the target would overshoot, and a fast approach shortens the decay instead
+        v0 = glm::min(velocity, 0.0f);
+        if (v0 < 0.0f)
+            duration = glm::min(duration, -5.0f * x0 / v0);
+
+        auto t1 = duration;
+        a0 = glm::max((-8.0f * v0 * t1 - 20.0f * x0) / (t1 * t1), 0.0f);
+        a = -(a0 * t1 * t1 + 6.0f * v0 * t1 + 12.0f * x0) / (2.0f * glm::pow(t1, 5.0f));
+        b = (3.0f * a0 * t1 * t1 + 16.0f * v0 * t1 + 30.0f * x0) / (2.0f * glm::pow(t1, 4.0f));
+        c = -(3.0f * a0 * t1 * t1 + 12.0f * v0 * t1 + 20.0f * x0) / (2.0f * t1 * t1 * t1);
+    }
+
+    auto Offset_Decay::at(float t) const -> float
+    {
+        if (t >= duration)
+            return 0.0f;
+        return ((((a * t + b) * t + c) * t + 0.5f * a0) * t + v0) * t + x0;
+    }
+
+    // rotation from b to a on the short arc
+    static auto rotation_offset(const glm::quat& a, const glm::quat& b) -> glm::quat
+    {
+        auto q = a * glm::inverse(b);
+        return q.w < 0.0f ? -q : q;
+    }
+
+    auto Switch_Node::request(int state) -> void
+    {
+        if (state == active)
+            return;
+        // a switch during a crossfade drops the older source, inertialization starts from wherever the
+        // pose is, offsets included
+        source = active;
+        active = state;
+        elapsed = 0.0f;
+        offsets_pending = true;
+        cost = {mode};
+    }
+
+    auto Switch_Node::record_offsets(const Pose& target) -> void
+    {
+        offsets.resize(target.size());
+        auto has_velocity = before_last_pose.size() == target.size() && last_delta_time > 0.0f;
+        for (auto i = 0; i < target.size(); i++) {
+            auto& offset = offsets[i];
+            auto& last = last_pose[i];
+
+            auto position = last.position - target[i].position;
+            auto length = glm::length(position);
+            offset.position_axis = length > 1e-6f ? position / length : glm::vec3(0.0f);
+            auto position_velocity = has_velocity ? glm::dot(last.position - before_last_pose[i].position, offset.position_axis) / last_delta_time : 0.0f;
+            offset.position.init(length, position_velocity, blend_time);
+
+            auto q = rotation_offset(last.rotation, target[i].rotation);
+            auto angle = glm::angle(q);
+            offset.rotation_axis = angle > 1e-6f ? glm::axis(q) : glm::vec3(0.0f, 0.0f, 1.0f);
+            auto angle_velocity = 0.0f;
+            if (has_velocity) {
+                // angle of the previous offset around this offset's axis
+                auto q_before = rotation_offset(before_last_pose[i].rotation, target[i].rotation);
+                auto angle_before = 2.0f * glm::atan(glm::dot(glm::vec3(q_before.x, q_before.y, q_before.z), offset.rotation_axis), q_before.w);
+                angle_velocity = (angle - angle_before) / last_delta_time;
+            }
+            offset.rotation.init(angle, angle_velocity, blend_time);
+
+            auto scale = last.scale - target[i].scale;
+            auto scale_length = glm::length(scale);
+            offset.scale_axis = scale_length > 1e-6f ? scale / scale_length : glm::vec3(0.0f);
+            auto scale_velocity = has_velocity ? glm::dot(last.scale - before_last_pose[i].scale, offset.scale_axis) / last_delta_time : 0.0f;
+            offset.scale.init(scale_length, scale_velocity, blend_time);
+        }
+    }
+
+    auto Switch_Node::apply_offsets(Pose& out) const -> void
+    {
+        for (auto i = 0; i < offsets.size(); i++) {
+            auto& offset = offsets[i];
+            out[i].position += offset.position_axis * offset.position.at(elapsed);
+            out[i].rotation = glm::angleAxis(offset.rotation.at(elapsed), offset.rotation_axis) * out[i].rotation;
+            out[i].scale += offset.scale_axis * offset.scale.at(elapsed);
+        }
+    }
+
+    auto Switch_Node::evaluate(Context& context, float weight, Pose& out) -> void
+    {
+        context.visited_nodes++;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto clips_before = context.sampled_clips;
+        auto was_transitioning = transitioning();
+
+        if (!transitioning()) {
+            states[active]->evaluate(context, weight, out);
+        } else if (mode == Transition_Mode::inertialize) {
+            states[active]->evaluate(context, weight, out);
+            if (offsets_pending) {
+                // nothing played before the first frame, there is nothing to decay from
+                if (last_pose.size() == out.size())
+                    record_offsets(out);
+                else
+                    offsets.clear();
+                offsets_pending = false;
+            }
+            apply_offsets(out);
+        } else {
+            auto fade = glm::clamp(elapsed / blend_time, 0.0f, 1.0f);
+            if (weight * fade < min_weight) {
+                states[source]->evaluate(context, weight, out);
+                states[active]->advance(context);
+            } else if (weight * (1.0f - fade) < min_weight) {
+                states[active]->evaluate(context, weight, out);
+                states[source]->advance(context);
+            } else {
+                auto source_pose = Pooled_Pose(context.pool);
+                states[source]->evaluate(context, weight * (1.0f - fade), source_pose.get());
+                states[active]->evaluate(context, weight * fade, out);
+                auto weight_sum = 1.0f - fade;
+                accumulate(context, source_pose.get(), out, fade, weight_sum);
+                out = source_pose.get();
+            }
+        }
+
+        before_last_pose.swap(last_pose);
+        last_pose = out;
+        last_delta_time = context.delta_time;
+
+        if (!was_transitioning)
+            return;
+        cost.frames++;
+        cost.sampled_clips += context.sampled_clips - clips_before;
+        cost.seconds += std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - start).count();
+        elapsed += context.delta_time;
+        if (elapsed >= blend_time) {
+            source = -1;
+            last_cost = cost;
+            std::cout << std::format("{} transition: {:d} frames, {:.1f} clips and {:.1f} us per frame\n",
+                mode == Transition_Mode::inertialize ? "inertialized" : "crossfade", cost.frames,
+                float(cost.sampled_clips) / cost.frames, cost.seconds * 1e6f / cost.frames);
+        }
+    }
+
+    auto Switch_Node::advance(Context& context) -> void
+    {
+        states[active]->advance(context);
+        if (transitioning() && mode == Transition_Mode::crossfade)
+            states[source]->advance(context);
+    }
+
+    auto Switch_Node::node_num() const -> int
+    {
+        auto num = 1;
+        for (auto& state: states)
+            num += state->node_num();
+        return num;
+    }
+
+    auto Graph::init(assimp_model::Model& model) -> void
+    {
+        context.model = &model;
+        context.pool.bone_num = int(model.bone_name_to_id.size());
+    }
+
+    auto Graph::evaluate(float delta_time) -> void
+    {
+        context.delta_time = delta_time;
+        context.visited_nodes = 0;
+        context.sampled_clips = 0;
+
+        auto pose = Pooled_Pose(context.pool);
+        root->evaluate(context, 1.0f, pose.get());
+        context.model->upload_pose(pose.get());
+        context.model->bind_textures();
+    }
+} // namespace Anim_Graph
@@ -0,0 +1,289 @@
+#pragma once
+
+#include "mesh.hpp"
+#include "blend-space.hpp"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Anim_Graph
+{
+    using Pose = std::vector<assimp_model::Bone_Trans>;
+
+    // Every intermediate pose of an evaluation comes from here, so a frame allocates nothing once the
+    // pool has seen the graph's deepest branch. peak_in_use tracks that depth.
+    struct Pose_Pool final
+    {
+        int bone_num{};
+        // a deque keeps poses in place while the pool grows under a live Pooled_Pose
+        std::deque<Pose> poses{};
+        std::vector<int> free_ids{};
+        int in_use{};
+        int peak_in_use{};
+
+        auto acquire() -> int;
+
+        auto release(int id) -> void
+        {
+            free_ids.emplace_back(id);
+            in_use--;
+        }
+    };
+
+    // pose borrowed from a pool for one scope
+    struct Pooled_Pose final
+    {
+        Pose_Pool* pool{nullptr};
+        int id{-1};
+
+        explicit Pooled_Pose(Pose_Pool& from) : pool(&from), id(from.acquire()) {}
+        Pooled_Pose(const Pooled_Pose&) = delete;
+        auto operator=(const Pooled_Pose&) -> Pooled_Pose& = delete;
+        ~Pooled_Pose()
+        {
+            pool->release(id);
+        }
+
+        auto get() -> Pose&
+        {
+            return pool->poses[id];
+        }
+    };
+
+    struct Context final
+    {
+        assimp_model::Model* model{nullptr};
+        Pose_Pool pool{};
+        float delta_time{};
+
+        // bones the current subtree writes, sorted; nullptr is the whole pose
+        const std::vector<int>* bones{nullptr};
+
+        // per evaluation, compare against Node::node_num of the root
+        int visited_nodes{};
+        int sampled_clips{};
+    };
+
+    // below this a branch contributes nothing visible and is skipped with its whole subtree
+    constexpr float min_weight = 1e-4f;
+
+    template <typename Fn>
+    auto for_each_bone(const Context& context, int bone_num, Fn&& fn) -> void
+    {
+        if (context.bones) {
+            for (auto bone: *context.bones)
+                fn(bone);
+        } else {
+            for (auto bone = 0; bone < bone_num; bone++)
+                fn(bone);
+        }
+    }
+
+    // running weighted average: after every input acc holds the blend of all inputs so far
+    auto accumulate(const Context& context, Pose& acc, const Pose& pose, float weight, float& weight_sum) -> void;
+
+    // Sorted bone ids a layer is limited to, e.g. the subtree under spine_02 for the upper body.
+    // Empty means the whole skeleton.
+    struct Bone_Mask final
+    {
+        std::vector<int> bones{};
+
+        // the bone and everything under it through Bone::child_id
+        auto add_subtree(const assimp_model::Model& model, const std::string& root_name) -> void;
+    };
+
+    struct Node
+    {
+        virtual ~Node() = default;
+
+        // writes this node's pose into out; weight is the node's share of the final pose, a child
+        // only runs when its own share stays above min_weight
+        virtual auto evaluate(Context& context, float weight, Pose& out) -> void = 0;
+
+        // a skipped subtree still moves its clips on, so a blend corner that comes back is in phase
+        virtual auto advance(Context& context) -> void = 0;
+
+        // nodes in this subtree, for comparing against what one evaluation visits
+        virtual auto node_num() const -> int
+        {
+            return 1;
+        }
+    };
+
+    struct Clip_Node final : Node
+    {
+        int track_id{};
+        float time{};
+        float speed{1.0f};
+
+        explicit Clip_Node(int track) : track_id(track) {}
+
+        // a clip samples the same at any weight
+        auto evaluate(Context& context, float, Pose& out) -> void override;
+
+        auto advance(Context& context) -> void override
+        {
+            time += context.delta_time * speed;
+        }
+    };
+
+    // D = 1 or 2: children sit at points of a Blendspace::Blend_Space<D> whose track ids are child indices
+    template <int D>
+    struct Blend_Node final : Node
+    {
+        Blendspace::Blend_Space<D> space{};
+        std::vector<Blendspace::Point<D>> points{};
+        std::vector<std::unique_ptr<Node>> children{};
+        Blendspace::Point<D> parameter{};
+        int last_simplex{-1};
+        Blendspace::Blend_Weights weights{};
+
+        auto add(const Blendspace::Point<D>& point, std::unique_ptr<Node> child) -> Node&;
+
+        // after the last add
+        auto build() -> void;
+
+        auto evaluate(Context& context, float weight, Pose& out) -> void override;
+
+        auto advance(Context& context) -> void override;
+
+        auto node_num() const -> int override;
+    };
+
+    using Blend_1D_Node = Blend_Node<1>;
+    using Blend_2D_Node = Blend_Node<2>;
+
+    // a blend node with one clip per "node" entry of a blend space file like blend-space.json
+    template <int D>
+    auto load_blend(const std::string path) -> std::unique_ptr<Blend_Node<D>>;
+
+    // base plus alpha times additive, whose clips play tracks made by Model::make_additive at import
+    struct Additive_Node final : Node
+    {
+        std::unique_ptr<Node> base{};
+        std::unique_ptr<Node> additive{};
+        float alpha{1.0f};
+
+        auto evaluate(Context& context, float weight, Pose& out) -> void override;
+
+        auto advance(Context& context) -> void override;
+
+        auto node_num() const -> int override;
+    };
+
+    // Layers go over the base in order, each by its own weight and on its own bones. An override layer
+    // replaces the pose, an additive one adds its deltas (tracks from Model::make_additive).
+    struct Layered_Node final : Node
+    {
+        struct Layer final
+        {
+            std::unique_ptr<Node> node{};
+            float weight{1.0f};
+            Bone_Mask mask{};
+            bool additive{false};
+        };
+
+        std::unique_ptr<Node> base{};
+        std::vector<Layer> layers{};
+
+        auto evaluate(Context& context, float weight, Pose& out) -> void override;
+
+        auto advance(Context& context) -> void override;
+
+        auto node_num() const -> int override;
+    };
+
+    enum struct Transition_Mode
+    {
+        // source and target both run until the fade ends
+        crossfade,
+        // only the target runs, the jump to it decays as a polynomial offset
+        inertialize,
+    };
+
+    // what one transition cost, summed over its frames
+    struct Transition_Cost final
+    {
+        Transition_Mode mode{};
+        int frames{};
+        int sampled_clips{};
+        float seconds{};
+    };
+
+    // Quintic that takes an offset x0 moving at v0 to rest at zero after duration, without overshoot
+    // (Bollo, "Inertialization: High-Performance Animation Transitions in Gears of War").
+    struct Offset_Decay final
+    {
+        float x0{}, v0{}, a0{}, a{}, b{}, c{};
+        float duration{};
+
+        auto init(float offset, float velocity, float blend_time) -> void;
+
+        auto at(float t) const -> float;
+    };
+
+    // per bone jump between the last output of the source and the first of the target
+    struct Bone_Offset final
+    {
+        glm::vec3 position_axis{};
+        Offset_Decay position{};
+        glm::vec3 rotation_axis{0.0f, 0.0f, 1.0f};
+        Offset_Decay rotation{};
+        glm::vec3 scale_axis{};
+        Offset_Decay scale{};
+    };
+
+    // Plays one of its states and switches between them with a crossfade or by inertialization.
+    // The last two outputs are kept so a switch knows where the pose was and how fast it moved.
+    struct Switch_Node final : Node
+    {
+        std::vector<std::unique_ptr<Node>> states{};
+        int active{};
+        int source{-1};
+
+        Transition_Mode mode{Transition_Mode::inertialize};
+        float blend_time{0.2f};
+        float elapsed{};
+        bool offsets_pending{false};
+        std::vector<Bone_Offset> offsets{};
+
+        Pose last_pose{};
+        Pose before_last_pose{};
+        float last_delta_time{};
+
+        Transition_Cost cost{};
+        Transition_Cost last_cost{};
+
+        auto request(int state) -> void;
+
+        auto transitioning() const -> bool
+        {
+            return source >= 0;
+        }
+
+        auto evaluate(Context& context, float weight, Pose& out) -> void override;
+
+        auto advance(Context& context) -> void override;
+
+        auto node_num() const -> int override;
+
+        // offsets from last_pose to target, velocities from the frame before over last_delta_time
+        auto record_offsets(const Pose& target) -> void;
+
+        auto apply_offsets(Pose& out) const -> void;
+    };
+
+    // Owns a tree of nodes and the pool behind it. evaluate() runs the tree top down and hands the
+    // result to Model::upload_pose.
+    struct Graph final
+    {
+        Context context{};
+        std::unique_ptr<Node> root{};
+
+        auto init(assimp_model::Model& model) -> void;
+
+        auto evaluate(float delta_time) -> void;
+    };
+} // namespace Anim_Graph
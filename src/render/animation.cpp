@@ -1,16 +1,25 @@
 #include "animation.hpp"
 
 #include "render/cmake-source-dir.hpp"
+#include "delaunay.hpp"
+#include "blend-space.hpp"
+#include "render.hpp"
 
 #include <assert.h>
+#include <algorithm>
 
 #include <nlohmann/json.hpp>
 #include <fstream>
+#include <sstream>
+#include <format>
+#include <iostream>
+#include <random>
+#include <chrono>
 
 
 namespace Blendspace2D
 {
-    auto Triangle::get_weight(glm::vec2 p) -> glm::vec3 {
+    auto Triangle::get_weight(glm::vec2 p) const -> glm::vec3 {
         auto weight_x = (- (p.x - p1.position.x) * (p2.position.y - p1.position.y) + (p.y - p1.position.y) * (p2.position.x - p1.position.x))
                         / (- (p0.position.x - p1.position.x) * (p2.position.y - p1.position.y) + (p0.position.y - p1.position.y) * (p2.position.x - p1.position.x));
 
@@ -27,65 +36,18 @@ namespace Blendspace2D
         return w.x >= 0.0f && w.y >= 0.0f && w.z >= 0.0f;
     }
 
-    auto Triangle::get_circumscribed_circle() -> glm::vec3 {
-        auto a = glm::distance(p0.position, p1.position);
-        auto b = glm::distance(p2.position, p0.position);
-        auto c = glm::distance(p2.position, p1.position);
-        auto radius = (a * b * c) / glm::sqrt((a + b + c) * (b + c - a)*(c + a - b) * ( a + b - c));
-        auto d = 2 * (p0.position.x * (p1.position.y - p2.position.y) + p1.position.x * (p2.position.y - p0.position.y) + p2.position.x * (p0.position.y - p1.position.y));
-        auto xp = ((p0.position.x * p0.position.x + p0.position.y * p0.position.y) * (p1.position.y - p2.position.y) + (p1.position.x * p1.position.x + p1.position.y * p1.position.y) * (p2.position.y - p0.position.y) + (p2.position.x * p2.position.x + p2.position.y * p2.position.y) * (p0.position.y - p1.position.y)) / d;
-        auto yp = ((p0.position.x * p0.position.x + p0.position.y * p0.position.y) * (p2.position.x - p1.position.x) + (p1.position.x * p1.position.x + p1.position.y * p1.position.y) * (p0.position.x - p2.position.x) + (p2.position.x * p2.position.x + p2.position.y * p2.position.y) * (p1.position.x - p0.position.x)) / d;
-        return glm::vec3{xp, yp, radius};
-    }
-
-    auto Triangle::share_edge_with(Triangle& t) -> bool {
-        auto cnt{0};
-        if (in_triangle(t.p0))
-            cnt++;
-        if (in_triangle(t.p1))
-            cnt++;
-        if (in_triangle(t.p2))
-            cnt++;
-        return cnt >= 2 ;
-    }
-
-    auto Triangle::is_convex_with(Triangle& t) -> bool {
-        if (!share_edge_with(t)) {
-            return false;
-        }
-        auto& poly_p0 = p0;
-        auto& poly_p1 = p1;
-        auto& poly_p2 = p2;
-        auto& poly_p3 = !in_triangle(t.p0) ? t.p0 : !in_triangle(t.p1) ? t.p1 : t.p2;
-
-        auto in_poly0 = Triangle{poly_p3, poly_p1, poly_p2}.inside_triangle(poly_p0.position);
-        auto in_poly1 = Triangle{poly_p0, poly_p3, poly_p2}.inside_triangle(poly_p1.position);
-        auto in_poly2 = Triangle{poly_p0, poly_p1, poly_p3}.inside_triangle(poly_p2.position);
-        auto in_poly3 = Triangle{poly_p0, poly_p1, poly_p2}.inside_triangle(poly_p3.position);
-
-        return in_poly0 || in_poly1 || in_poly2 || in_poly3;
-    }
-
-    auto Triangle::in_triangle(Node& n) -> bool {
-        return n == p0 || n == p1 || n == p2;
-    }
-
     auto Blend_Space_2D::init(assimp_model::Model& model, const std::string path) -> void {
         frame_ids.resize(model.tracks.size(), 0);
 
-        blend_weight.resize(3, 0);
-        track_ids.resize(3, 0);
+        current.track_ids.assign(3, 0);
+        current.weights.assign(3, 0.0f);
 
         std::ifstream config_fs(ROOT_DIR + path);
 
         auto config = nlohmann::json::parse(config_fs, nullptr, true, true);
 
         std::vector<Node> tmp_nodes{};
-
-        auto max_x{-INFINITY};
-        auto max_y{-INFINITY};
-        auto min_x{INFINITY};
-        auto min_y{INFINITY};
+        std::vector<glm::vec2> positions{};
 
         auto& nodes = config.find("node").value();
         for (auto& node: nodes) {
@@ -93,138 +55,411 @@ namespace Blendspace2D
             float y = node.find("y").value();
             int track_id = node.find("anim_id").value();
             tmp_nodes.emplace_back(glm::vec2{x, y}, track_id);
-            if (x > max_x) {
-                max_x = x;
-            }
-            if (x < min_x) {
-                min_x = x;
+            positions.emplace_back(x, y);
+        }
+
+        // nodes sharing a position keep the first one's track
+        auto delaunay = Delaunay{};
+        delaunay.build(positions);
+
+        triangles.clear();
+        for (auto& v: delaunay.triangles) {
+            triangles.emplace_back(tmp_nodes[v.x], tmp_nodes[v.y], tmp_nodes[v.z]);
+        }
+        adjacency = delaunay.neighbors;
+        build_locator();
+        std::cout << std::format("blend space {:d} nodes, {:d} triangles\n", tmp_nodes.size(), triangles.size());
+    }
+
+    auto Blend_Space_2D::build_locator() -> void {
+        frames.assign(triangles.size(), Barycentric_Frame{});
+        last_triangle = -1;
+
+        auto min_p = glm::vec2{INFINITY};
+        auto max_p = glm::vec2{-INFINITY};
+        for (auto t = 0; t < triangles.size(); t++) {
+            auto& triangle = triangles[t];
+            auto& frame = frames[t];
+            auto e0 = triangle.p0.position - triangle.p2.position;
+            auto e1 = triangle.p1.position - triangle.p2.position;
+            auto det = e0.x * e1.y - e0.y * e1.x;
+            frame.origin = triangle.p2.position;
+            frame.degenerate = glm::abs(det) < 1e-12f;
+            if (!frame.degenerate)
+                frame.inverse = glm::inverse(glm::mat2{e0, e1});
+
+            for (auto& n: {triangle.p0, triangle.p1, triangle.p2}) {
+                min_p = glm::min(min_p, n.position);
+                max_p = glm::max(max_p, n.position);
             }
-            if (y > max_y) {
-                max_y = y;
+        }
+
+        // about one triangle per cell
+        auto side = glm::clamp(int(glm::ceil(glm::sqrt(float(triangles.size())))), 1, 256);
+        grid.origin = triangles.empty() ? glm::vec2{0.0f} : min_p;
+        grid.dims = glm::ivec2{side};
+        grid.cell_size = triangles.empty() ? glm::vec2{1.0f} : glm::max((max_p - min_p) / float(side), glm::vec2{1e-6f});
+
+        auto cell_range = [&](const Triangle& triangle) -> std::pair<glm::ivec2, glm::ivec2> {
+            auto lo = glm::min(triangle.p0.position, glm::min(triangle.p1.position, triangle.p2.position));
+            auto hi = glm::max(triangle.p0.position, glm::max(triangle.p1.position, triangle.p2.position));
+            auto clamp_cell = [&](glm::vec2 p) -> glm::ivec2 {
+                return glm::clamp(glm::ivec2(glm::floor((p - grid.origin) / grid.cell_size)), glm::ivec2(0), grid.dims - 1);
+            };
+            return {clamp_cell(lo), clamp_cell(hi)};
+        };
+        grid.cell_start.assign(grid.dims.x * grid.dims.y + 1, 0);
+        for (auto& triangle: triangles) {
+            auto [lo, hi] = cell_range(triangle);
+            for (auto y = lo.y; y <= hi.y; y++)
+                for (auto x = lo.x; x <= hi.x; x++)
+                    grid.cell_start[x + grid.dims.x * y + 1]++;
+        }
+        for (auto c = 0; c + 1 < grid.cell_start.size(); c++)
+            grid.cell_start[c + 1] += grid.cell_start[c];
+        grid.cell_triangles.resize(grid.cell_start.back());
+        auto fill = std::vector<int>(grid.cell_start.begin(), grid.cell_start.end() - 1);
+        for (auto t = 0; t < triangles.size(); t++) {
+            auto [lo, hi] = cell_range(triangles[t]);
+            for (auto y = lo.y; y <= hi.y; y++)
+                for (auto x = lo.x; x <= hi.x; x++)
+                    grid.cell_triangles[fill[x + grid.dims.x * y]++] = t;
+        }
+    }
+
+    auto Blend_Space_2D::locate(glm::vec2 p, int hint) const -> Location {
+        constexpr auto eps = -1e-6f;
+        auto inside = [&](const glm::vec3& w) -> bool {
+            return w.x >= eps && w.y >= eps && w.z >= eps;
+        };
+
+        // step across the edge opposite the most negative weight, the usual visibility walk
+        auto t = hint;
+        for (auto step = 0; t >= 0 && step < max_walk; step++) {
+            if (frames[t].degenerate)
+                break;
+            auto w = frames[t].weight(p);
+            if (inside(w))
+                return {t, w};
+            auto k = w.x < w.y ? (w.x < w.z ? 0 : 2) : (w.y < w.z ? 1 : 2);
+            t = adjacency[t][k];
+        }
+
+        // no hint, a jump, or p left the hull: test the triangles overlapping p's cell
+        if (grid.cell_start.empty())
+            return {};
+        auto cell = grid.cell_of(p);
+        for (auto i = grid.cell_start[cell]; i < grid.cell_start[cell + 1]; i++) {
+            auto candidate = grid.cell_triangles[i];
+            if (frames[candidate].degenerate)
+                continue;
+            auto w = frames[candidate].weight(p);
+            if (inside(w))
+                return {candidate, w};
+        }
+        return {};
+    }
+
+    auto Blend_Space_2D::bake_weights(glm::ivec2 resolution) -> void {
+        bake.resolution = glm::max(resolution, glm::ivec2(1));
+        bake.origin = grid.origin;
+        bake.cell_size = grid.cell_size * glm::vec2(grid.dims) / glm::vec2(bake.resolution);
+        bake.cells.assign(bake.resolution.x * bake.resolution.y, Baked_Cell{});
+
+        // rows are walked in order, so every locate starts next to its answer
+        auto hint{-1};
+        for (auto c = 0; c < bake.cells.size(); c++) {
+            auto& cell = bake.cells[c];
+            auto center = bake.cell_center(c);
+            auto location = locate(center, hint);
+            if (location.triangle < 0)
+                continue;
+            hint = location.triangle;
+
+            auto& frame = frames[location.triangle];
+            cell.triangle = location.triangle;
+            cell.weight = location.weight;
+            cell.d_dx = glm::vec3{frame.inverse[0], -frame.inverse[0].x - frame.inverse[0].y};
+            cell.d_dy = glm::vec3{frame.inverse[1], -frame.inverse[1].x - frame.inverse[1].y};
+
+            // triangles are convex, four corners inside means the whole cell is
+            cell.exact = true;
+            for (auto corner: {glm::vec2{-0.5f, -0.5f}, glm::vec2{0.5f, -0.5f}, glm::vec2{-0.5f, 0.5f}, glm::vec2{0.5f, 0.5f}}) {
+                auto w = frame.weight(center + corner * bake.cell_size);
+                cell.exact = cell.exact && w.x >= 0.0f && w.y >= 0.0f && w.z >= 0.0f;
             }
-            if (y < min_y) {
-                min_y = y;
+        }
+    }
+
+    auto Blend_Space_2D::upload_bake() -> void {
+        auto texels = std::vector<glm::vec4>{};
+        texels.reserve(bake.cells.size() * 3);
+        for (auto& cell: bake.cells) {
+            auto tracks = glm::vec3{-1.0f};
+            if (cell.triangle >= 0) {
+                auto& t = triangles[cell.triangle];
+                tracks = {t.p0.track_id, t.p1.track_id, t.p2.track_id};
             }
+            texels.emplace_back(cell.weight.x, cell.weight.y, cell.d_dx.x, cell.d_dx.y);
+            texels.emplace_back(cell.d_dy.x, cell.d_dy.y, cell.exact ? 1.0f : 0.0f, 0.0f);
+            texels.emplace_back(tracks, float(cell.triangle));
         }
 
-        auto delaunay_triangulation = [&]() -> void {
-            auto p_max_max = Node{glm::vec2{max_x, max_y}, -1};
-            auto p_max_min = Node{glm::vec2{max_x, min_y}, -1};
-            auto p_min_max = Node{glm::vec2{min_x, max_y}, -1};
-            auto p_min_min = Node{glm::vec2{min_x, min_y}, -1};
-
-            triangles.emplace_back(p_max_max, p_min_max, p_min_min);
-            triangles.emplace_back(p_max_max, p_max_min, p_min_min);
-
-            for (auto& n: tmp_nodes) {
-                auto star_poly = std::vector<Node>{};
-                auto star_poly_point_set = std::unordered_set<Node, Node_Hash>{};
-                // auto in_star_poly{false};
-                for (auto it = triangles.begin(); it != triangles.end();) {
-                    auto& triangle = *it;
-                    auto info = triangle.get_circumscribed_circle();
-                    auto center = glm::vec2{info.x, info.y};
-                    if (glm::distance(n.position, center) < info.z - 0.001) {
-                        star_poly_point_set.emplace(triangle.p0);
-                        star_poly_point_set.emplace(triangle.p1);
-                        star_poly_point_set.emplace(triangle.p2);
-
-                        it = triangles.erase(it);
-                    } else {
-                        it++;
-                    }
-                }
+        if (bake.texture == 0)
+            glGenTextures(1, &bake.texture);
+        glBindTexture(GL_TEXTURE_2D, bake.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, bake.resolution.x * 3, bake.resolution.y, 0, GL_RGBA, GL_FLOAT, texels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        // texelFetch only, filtering would mix cells of different triangles
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        auto error = probe_bake();
+        if (error < 0.0f)
+            std::cout << "blend space bake: Blend_Space_Bake.glsl failed to compile, see the shader log above\n";
+        else
+            std::cout << std::format("blend space bake: gpu lookup off by {:.2e} from the cpu one\n", error);
+    }
+
+    auto Blend_Space_2D::probe_bake() const -> float {
+        std::ifstream sfs(ROOT_DIR + std::string("asset/shaders/Blend_Space_Bake.glsl"));
+        std::stringstream snippet{};
+        snippet << sfs.rdbuf() << "\n";
+        auto shader = render::Shader{{{GL_COMPUTE_SHADER, "asset/shaders/Blend_Space_Bake.comp"}}};
+        if (!shader.compile(snippet.str()))
+            return -1.0f;
+
+        // a quarter cell off the center of the first exact cell, so the gradient takes part
+        auto c = int(std::find_if(bake.cells.begin(), bake.cells.end(), [](auto& cell) { return cell.exact; }) - bake.cells.begin());
+        auto error = 0.0f;
+        if (c < bake.cells.size()) {
+            auto p = bake.cell_center(c) + 0.25f * bake.cell_size;
+            shader.setUniform2fv("probe", p);
+            shader.setUniform2fv("blend_bake_origin", bake.origin);
+            shader.setUniform2fv("blend_bake_cell_size", bake.cell_size);
+            glProgramUniform2i(shader.program_id, shader.uniform_location("blend_bake_resolution"), bake.resolution.x, bake.resolution.y);
+            shader.setUniform1i("blend_bake", 0);
+
+            struct Probe final
+            {
+                glm::vec4 weight{};
+                glm::ivec4 tracks{};
+            };
+            auto result = Probe{};
+            auto buffer = GLuint{};
+            glCreateBuffers(1, &buffer);
+            glNamedBufferData(buffer, sizeof(Probe), nullptr, GL_DYNAMIC_READ);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+            glBindTextureUnit(0, bake.texture);
+            shader.apply();
+            glDispatchCompute(1, 1, 1);
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            // blocks, once per upload
+            glGetNamedBufferSubData(buffer, 0, sizeof(Probe), &result);
+            glDeleteBuffers(1, &buffer);
+            glBindTextureUnit(0, 0);
+
+            auto location = lookup(p, -1);
+            auto& triangle = triangles[location.triangle];
+            error = glm::length(glm::vec3(result.weight) - location.weight);
+            if (result.weight.w == 0.0f || glm::ivec3(result.tracks) != glm::ivec3{triangle.p0.track_id, triangle.p1.track_id, triangle.p2.track_id})
+                error = INFINITY;
+        }
+        shader.release();
+        return error;
+    }
 
-                auto angle_greater = [&](auto& p1, auto& p2) -> bool {
-                    return glm::orientedAngle(glm::normalize(p1.position - n.position), glm::vec2{1.0f, 0.0f}) > glm::orientedAngle(glm::normalize(p2.position - n.position), glm::vec2{1.0f, 0.0f});
-                };
+    auto Blend_Space_2D::release_bake() -> void {
+        if (bake.texture != 0)
+            glDeleteTextures(1, &bake.texture);
+        bake.texture = 0;
+    }
 
-                if (!star_poly_point_set.empty()) {
-                    for (auto& p: star_poly_point_set) {
-                        star_poly.emplace_back(p);
-                    }
-                    std::sort(
-                        star_poly.begin(),
-                        star_poly.end(),
-                        angle_greater
-                    );
-                    for (auto i = 0; i < star_poly.size() - 1; i++) {
-                        triangles.emplace_back(n, star_poly[i], star_poly[i + 1]);
-                    }
-                    // if (in_star_poly)
-                    triangles.emplace_back(n, star_poly.back(), star_poly.front());
-                }
+    auto Blend_Space_2D::lookup(glm::vec2 p, int hint) const -> Location {
+        auto c = bake.cell_index(p);
+        if (c < 0 || !bake.cells[c].exact)
+            return locate(p, hint);
+        auto& cell = bake.cells[c];
+        auto d = p - bake.cell_center(c);
+        return {cell.triangle, cell.weight + cell.d_dx * d.x + cell.d_dy * d.y};
+    }
+
+    auto Blend_Space_2D::weigh(const Location& location, Blendspace::Blend_Weights& out) const -> void {
+        auto& triangle = triangles[location.triangle];
+        out.track_ids = {triangle.p0.track_id, triangle.p1.track_id, triangle.p2.track_id};
+        out.weights = {location.weight.x, location.weight.y, location.weight.z};
+    }
+
+    auto Blend_Space_2D::compare_bake(int samples) const -> Bake_Accuracy {
+        auto accuracy = Bake_Accuracy{samples};
+        if (bake.cells.empty() || samples <= 0)
+            return accuracy;
+
+        auto rng = std::mt19937{1};
+        auto distribution = std::uniform_real_distribution<float>(0.0f, 1.0f);
+        auto extent = bake.cell_size * glm::vec2(bake.resolution);
+        auto points = std::vector<glm::vec2>(samples);
+        for (auto& p: points)
+            p = bake.origin + glm::vec2{distribution(rng), distribution(rng)} * extent;
+
+        auto analytic = std::vector<Location>(samples);
+        auto baked = std::vector<Location>(samples);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (auto i = 0; i < samples; i++)
+            analytic[i] = locate(points[i], -1);
+        auto middle = std::chrono::high_resolution_clock::now();
+        for (auto i = 0; i < samples; i++)
+            baked[i] = lookup(points[i], -1);
+        auto end = std::chrono::high_resolution_clock::now();
+        accuracy.analytic_ns = std::chrono::duration<float, std::nano>(middle - start).count() / samples;
+        accuracy.baked_ns = std::chrono::duration<float, std::nano>(end - middle).count() / samples;
+
+        auto exact_num{0};
+        auto compared{0};
+        for (auto i = 0; i < samples; i++) {
+            auto c = bake.cell_index(points[i]);
+            exact_num += c >= 0 && bake.cells[c].exact;
+            if (analytic[i].triangle < 0)
+                continue;
+            compared++;
+            auto error = glm::length(baked[i].weight - analytic[i].weight);
+            accuracy.max_error = glm::max(accuracy.max_error, error);
+            accuracy.mean_error += error;
+
+            // weights of another triangle blend other tracks, there is no distance to report
+            if (c < 0 || bake.cells[c].triangle != analytic[i].triangle) {
+                accuracy.center_mismatch += 1.0f;
+                continue;
             }
-            auto triangles_to_be_remove = std::vector<Triangle>{};
-            for (auto it = triangles.begin(); it != triangles.end(); ) {
-                auto& t = *it;
-                if (t.p0.track_id == -1 || t.p1.track_id == -1 || t.p2.track_id == -1) {
-                    triangles_to_be_remove.emplace_back(t);
-                    it = triangles.erase(it);
-                } else {
-                    it++;
-                }
+            auto center_error = glm::length(bake.cells[c].weight - analytic[i].weight);
+            accuracy.center_max_error = glm::max(accuracy.center_max_error, center_error);
+            accuracy.center_mean_error += center_error;
+        }
+        accuracy.exact_fraction = float(exact_num) / samples;
+        if (compared > 0) {
+            accuracy.mean_error /= compared;
+            accuracy.center_mean_error /= glm::max(compared - accuracy.center_mismatch, 1.0f);
+            accuracy.center_mismatch /= compared;
+        }
+        return accuracy;
+    }
+
+    auto Blend_Space_2D::evaluate_batch(Blend_Batch& batch, bool simd) const -> void {
+        auto n = int(batch.queries.size());
+        auto cell_num = grid.dims.x * grid.dims.y;
+        batch.samples.assign(n, Blend_Sample{});
+        if (grid.cell_start.empty() || n == 0)
+            return;
+
+        // counting sort by cell, queries of one cell end up contiguous
+        batch.cell_start.assign(cell_num + 1, 0);
+        for (auto& q: batch.queries)
+            batch.cell_start[grid.cell_of(q) + 1]++;
+        for (auto c = 0; c < cell_num; c++)
+            batch.cell_start[c + 1] += batch.cell_start[c];
+
+        batch.order.resize(n);
+        batch.qx.resize(n);
+        batch.qy.resize(n);
+        auto fill = std::vector<int>(batch.cell_start.begin(), batch.cell_start.end() - 1);
+        for (auto i = 0; i < n; i++) {
+            auto slot = fill[grid.cell_of(batch.queries[i])]++;
+            batch.order[slot] = i;
+            batch.qx[slot] = batch.queries[i].x;
+            batch.qy[slot] = batch.queries[i].y;
+        }
+
+        batch.sorted_triangle.assign(n, -1);
+        batch.sorted_weight.assign(n, glm::vec3{0.0f});
+        for (auto c = 0; c < cell_num; c++) {
+            auto begin = batch.cell_start[c];
+            auto end = batch.cell_start[c + 1];
+            if (begin == end)
+                continue;
+            if (simd)
+                resolve_cell_simd(c, batch, begin, end);
+            else
+                resolve_cell(c, batch, begin, end);
+        }
+
+        for (auto slot = 0; slot < n; slot++) {
+            auto t = batch.sorted_triangle[slot];
+            if (t < 0)
+                continue;
+            auto& sample = batch.samples[batch.order[slot]];
+            sample.triangle = t;
+            sample.weights = batch.sorted_weight[slot];
+            sample.track_ids = {triangles[t].p0.track_id, triangles[t].p1.track_id, triangles[t].p2.track_id};
+        }
+    }
+
+    auto Blend_Space_2D::benchmark_batch(int agent_num) const -> Batch_Bench {
+        auto bench = Batch_Bench{agent_num};
+        if (triangles.empty() || agent_num <= 0)
+            return bench;
+
+        auto rng = std::mt19937{1};
+        auto distribution = std::uniform_real_distribution<float>(0.0f, 1.0f);
+        auto extent = grid.cell_size * glm::vec2(grid.dims);
+        auto batch = Blend_Batch{};
+        batch.queries.resize(agent_num);
+        for (auto& q: batch.queries)
+            q = grid.origin + glm::vec2{distribution(rng), distribution(rng)} * extent;
+
+        auto agents_per_ms = [&](auto&& run) -> float {
+            // best of a few runs, the first one also warms the caches
+            auto best = INFINITY;
+            for (auto repeat = 0; repeat < 5; repeat++) {
+                auto start = std::chrono::high_resolution_clock::now();
+                run();
+                best = glm::min(best, std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count());
             }
+            return agent_num / glm::max(best, 1e-6f);
+        };
 
-            for (auto it = triangles_to_be_remove.begin(); it != triangles_to_be_remove.end(); it++) {
-                auto& t = *it;
-                for (auto it_ = it; it_ != triangles_to_be_remove.end(); it_++) {
-                    auto t_ = *it_;
-
-                    if (t.share_edge_with(t_) && !t.is_convex_with(t_)) {
-                        auto convex_polygon = Triangle{};
-                        std::unordered_set<Node, Node_Hash> uset;
-                        std::vector<Node> uvec{};
-                        uset.emplace(t.p0);
-                        uset.emplace(t.p1);
-                        uset.emplace(t.p2);
-                        uset.emplace(t_.p0);
-                        uset.emplace(t_.p1);
-                        uset.emplace(t_.p2);
-
-                        for (auto& p: uset) {
-                            if (p.track_id != -1)
-                                uvec.emplace_back(p);
+        auto samples = std::vector<Blend_Sample>(agent_num);
+        // the old per agent scan is quadratic, big blend spaces leave it at zero
+        if (double(triangles.size()) * agent_num < 2e8) {
+            bench.linear_scan = agents_per_ms([&] {
+                for (auto i = 0; i < agent_num; i++) {
+                    for (auto t = 0; t < triangles.size(); t++) {
+                        auto w = triangles[t].get_weight(batch.queries[i]);
+                        if (w.x >= 0.0f && w.y >= 0.0f && w.z >= 0.0f) {
+                            samples[i] = {{triangles[t].p0.track_id, triangles[t].p1.track_id, triangles[t].p2.track_id}, w, t};
+                            break;
                         }
-                        if (uvec.size() == 3)
-                            triangles.emplace_back(uvec[0], uvec[1], uvec[2]);
                     }
                 }
+            });
+        }
+        bench.locate = agents_per_ms([&] {
+            for (auto i = 0; i < agent_num; i++) {
+                auto location = locate(batch.queries[i], -1);
+                if (location.triangle >= 0) {
+                    auto& t = triangles[location.triangle];
+                    samples[i] = {{t.p0.track_id, t.p1.track_id, t.p2.track_id}, location.weight, location.triangle};
+                }
             }
-        };
-
-        delaunay_triangulation();
-        std::cout << "mk\n";
+        });
+        bench.batch = agents_per_ms([&] { evaluate_batch(batch, false); });
+        bench.batch_simd = agents_per_ms([&] { evaluate_batch(batch, true); });
+        return bench;
     }
 
     auto Blend_Space_2D::update(assimp_model::Model& model, glm::vec2 p, float& left_weight, float& right_weight) -> void {
         
-        if (right_weight >= 1.0f) {
-            for (auto i = 0; i < frame_ids.size(); i++) {
-                frame_ids[i]++;
-                if (frame_ids[i] >= model.tracks[i].duration - 1) {
-                    frame_ids[i] = 0;
-                }
-            }
-            left_weight = 1.0f;
-            right_weight = 0.0f;
-        }
+        Blendspace::advance_frames(model, frame_ids, left_weight, right_weight);
 
-        for (auto& triangle: triangles) {
-            auto w = triangle.get_weight(p);
-            if (w.x >= 0.0f && w.y >= 0.0f && w.z >= 0.0f) {
-                position = p;
-                blend_weight[0] = w.x;
-                blend_weight[1] = w.y;
-                blend_weight[2] = w.z;
-                track_ids[0] = triangle.p0.track_id;
-                track_ids[1] = triangle.p1.track_id;
-                track_ids[2] = triangle.p2.track_id;
-                break;
-            }
+        auto location = use_bake && !bake.cells.empty() ? lookup(p, last_triangle) : locate(p, last_triangle);
+        if (location.triangle >= 0) {
+            weigh(location, current);
+            last_triangle = location.triangle;
+            position = p;
         }
 
-        model.blend_tracks(frame_ids, track_ids, left_weight, right_weight, blend_weight);
+        model.blend_tracks(frame_ids, current.track_ids, left_weight, right_weight, current.weights);
         model.bind_textures();
     }
 } // namespace Blendspace2D
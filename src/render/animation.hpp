@@ -3,7 +3,6 @@
 #include <vector>
 #include <string>
 #include <unordered_map>
-#include <unordered_set>
 #include <functional>
 
 #ifndef IMGUI_DEFINE_MATH_OPERATORS
@@ -16,6 +15,7 @@
 #include <glm/gtx/vector_angle.hpp>
 
 #include "mesh.hpp"
+#include "blend-space.hpp"
 
 namespace Blendspace2D
 {
@@ -28,48 +28,210 @@ namespace Blendspace2D
         }
     };
 
-    struct Node_Hash final {
-        size_t operator()(const Node& t) const
-        {
-            std::hash<float> hash_float;
-            return hash_float(t.position.x) & hash_float(t.position.y) & hash_float(t.track_id);
-        }
-    };
-
     struct Triangle final
     {
         Node p0{};
         Node p1{};
         Node p2{};
 
-        auto get_weight(glm::vec2 p) -> glm::vec3;
+        auto get_weight(glm::vec2 p) const -> glm::vec3;
 
         auto inside_triangle(glm::vec2& p) -> bool;
-        // glm::vec3 z -> radius , x / y = center coordinate x / y
-        auto get_circumscribed_circle() -> glm::vec3;
+    };
+    // p = p2 + inverse^-1 * (w0, w1), so the weights of p0 and p1 are one matrix multiply away
+    struct Barycentric_Frame final
+    {
+        glm::vec2 origin{};
+        glm::mat2 inverse{0.0f};
+        bool degenerate{true};
+
+        auto weight(glm::vec2 p) const -> glm::vec3
+        {
+            auto w = inverse * (p - origin);
+            return glm::vec3{w.x, w.y, 1.0f - w.x - w.y};
+        }
+    };
+
+    // triangle ids whose bounding box overlaps each cell, packed as cell_start / cell_triangles
+    struct Triangle_Grid final
+    {
+        glm::vec2 origin{};
+        glm::vec2 cell_size{1.0f};
+        glm::ivec2 dims{1, 1};
+        std::vector<int> cell_start{};
+        std::vector<int> cell_triangles{};
+
+        auto cell_of(glm::vec2 p) const -> int
+        {
+            auto c = glm::clamp(glm::ivec2(glm::floor((p - origin) / cell_size)), glm::ivec2(0), dims - 1);
+            return c.x + dims.x * c.y;
+        }
+    };
+
+    struct Location final
+    {
+        // -1 when p lies outside every triangle
+        int triangle{-1};
+        glm::vec3 weight{};
+    };
+
+    // One cell of the baked weight grid. Inside a triangle the weights are affine in p, so the value
+    // at the cell center plus the triangle's gradient reproduces them exactly anywhere in the cell.
+    struct Baked_Cell final
+    {
+        glm::vec3 weight{};
+        glm::vec3 d_dx{};
+        glm::vec3 d_dy{};
+        // triangle under the cell center, -1 outside the blend space
+        int triangle{-1};
+        // the whole cell lies inside that triangle, otherwise lookups fall back to locate
+        bool exact{false};
+    };
+
+    struct Weight_Bake final
+    {
+        glm::ivec2 resolution{};
+        glm::vec2 origin{};
+        glm::vec2 cell_size{1.0f};
+        std::vector<Baked_Cell> cells{};
+
+        // RGBA32F, 3 texels per cell: (w0, w1, dw0/dx, dw1/dx), (dw0/dy, dw1/dy, exact, 0), (track0, track1, track2, triangle)
+        unsigned int texture{};
+
+        auto cell_index(glm::vec2 p) const -> int
+        {
+            auto c = glm::ivec2(glm::floor((p - origin) / cell_size));
+            if (glm::any(glm::lessThan(c, glm::ivec2(0))) || glm::any(glm::greaterThanEqual(c, resolution)))
+                return -1;
+            return c.x + resolution.x * c.y;
+        }
 
-        auto share_edge_with(Triangle& t) -> bool;
+        auto cell_center(int c) const -> glm::vec2
+        {
+            return origin + (glm::vec2{c % resolution.x, c / resolution.x} + 0.5f) * cell_size;
+        }
+    };
 
-        auto in_triangle(Node& n) -> bool;
+    struct Bake_Accuracy final
+    {
+        int samples{};
+        // cells lookups answer without locate
+        float exact_fraction{};
+        // baked lookup against locate
+        float max_error{};
+        float mean_error{};
+        // center weights only, what a lookup ignoring the gradient would get
+        float center_max_error{};
+        float center_mean_error{};
+        // fraction of samples whose cell center lies in another triangle
+        float center_mismatch{};
+        float baked_ns{};
+        float analytic_ns{};
+    };
 
-        auto is_convex_with(Triangle& t) -> bool;
+    // one agent's blend, triangle -1 and zero weights outside the blend space
+    struct Blend_Sample final
+    {
+        glm::ivec3 track_ids{-1};
+        glm::vec3 weights{};
+        int triangle{-1};
+    };
 
+    // Queries of many agents at once. evaluate_batch sorts them by locator cell, so every cell's
+    // candidate triangles are tested against a run of queries instead of once per agent.
+    struct Blend_Batch final
+    {
+        std::vector<glm::vec2> queries{};
+        // same order as queries
+        std::vector<Blend_Sample> samples{};
+
+        // scratch, kept so evaluating every frame does not allocate
+        std::vector<int> order{};
+        std::vector<int> cell_start{};
+        std::vector<float> qx{};
+        std::vector<float> qy{};
+        std::vector<int> sorted_triangle{};
+        std::vector<glm::vec3> sorted_weight{};
+    };
 
+    struct Batch_Bench final
+    {
+        int agent_num{};
+        // agents per millisecond
+        float linear_scan{};
+        float locate{};
+        float batch{};
+        float batch_simd{};
     };
+
     struct Blend_Space_2D final
     {
         glm::vec2 position{};
         std::vector<int> frame_ids{};
         // std::vector<int> track_len{};
         std::vector<Triangle> triangles{};
-        std::vector<float> blend_weight{};
-        std::vector<int> track_ids{};
+        // what update hands the pose blender, the same contract as Blendspace::Blend_Space
+        Blendspace::Blend_Weights current{};
+
+        // adjacency[t][k] is the triangle across the edge opposite corner k of t, -1 on the hull
+        std::vector<glm::ivec3> adjacency{};
+        std::vector<Barycentric_Frame> frames{};
+        Triangle_Grid grid{};
+
+        // where the previous update found its point, the next walk starts here
+        int last_triangle{-1};
+
+        // a walk longer than this is a jump, the grid is faster from there
+        static constexpr int max_walk = 8;
 
         // bool in_blend_space{true};
 
         // std::unordered_map<glm::vec2, int> point_to_track;
         auto init(assimp_model::Model& model, const std::string path) -> void;
 
+        // barycentric frames and the coarse grid, after triangles and adjacency changed
+        auto build_locator() -> void;
+
+        // walks from hint (a triangle id or -1) towards p, agents can keep their own hint
+        auto locate(glm::vec2 p, int hint) const -> Location;
+
+        Weight_Bake bake{};
+
+        // update reads the baked grid instead of walking, when one was baked
+        bool use_bake{false};
+
+        // resolution.x * resolution.y cells over the triangles' bounds
+        auto bake_weights(glm::ivec2 resolution) -> void;
+
+        // needs a current gl context, see Blend_Space_Bake.glsl for the shader side
+        auto upload_bake() -> void;
+
+        // compiles Blend_Space_Bake.glsl into Blend_Space_Bake.comp and compares one gpu lookup with lookup;
+        // the weight error, infinity when triangle or tracks differ, -1 when the snippet does not compile
+        auto probe_bake() const -> float;
+
+        // deletes bake.texture, while the gl context is still alive
+        auto release_bake() -> void;
+
+        // baked cell when it is exact, locate otherwise
+        auto lookup(glm::vec2 p, int hint) const -> Location;
+
+        // tracks of location's triangle with its weights
+        auto weigh(const Location& location, Blendspace::Blend_Weights& out) const -> void;
+
+        // uniform random points over the baked area, seeded so runs compare
+        auto compare_bake(int samples) const -> Bake_Accuracy;
+
+        auto evaluate_batch(Blend_Batch& batch, bool simd) const -> void;
+
+        // sorted queries [begin, end) all fall into grid cell `cell`, see blend-simd.cpp;
+        // without AVX2 the simd variant is the scalar one
+        auto resolve_cell(int cell, Blend_Batch& batch, int begin, int end) const -> void;
+        auto resolve_cell_simd(int cell, Blend_Batch& batch, int begin, int end) const -> void;
+
+        // agents spread over the blend space, per agent loops against the batch
+        auto benchmark_batch(int agent_num) const -> Batch_Bench;
+
         auto update(assimp_model::Model& model, glm::vec2 p, float& left_weight, float& right_weight) -> void;
     };
 } // namespace Blendspace2D
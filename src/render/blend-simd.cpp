@@ -0,0 +1,87 @@
+#include "animation.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Blendspace2D
+{
+    // Candidate triangles of the cell against one query at a time, the first one containing it wins.
+    auto Blend_Space_2D::resolve_cell(int cell, Blend_Batch& batch, int begin, int end) const -> void
+    {
+        constexpr auto eps = -1e-6f;
+        for (auto slot = begin; slot < end; slot++) {
+            auto p = glm::vec2{batch.qx[slot], batch.qy[slot]};
+            for (auto i = grid.cell_start[cell]; i < grid.cell_start[cell + 1]; i++) {
+                auto t = grid.cell_triangles[i];
+                if (frames[t].degenerate)
+                    continue;
+                auto w = frames[t].weight(p);
+                if (w.x >= eps && w.y >= eps && w.z >= eps) {
+                    batch.sorted_triangle[slot] = t;
+                    batch.sorted_weight[slot] = w;
+                    break;
+                }
+            }
+        }
+    }
+
+#if defined(__AVX2__)
+    // Same test with 8 queries per triangle: one broadcast frame, two multiply-adds per weight and a
+    // blend that keeps the first hit. A block stops once all its lanes are resolved.
+    auto Blend_Space_2D::resolve_cell_simd(int cell, Blend_Batch& batch, int begin, int end) const -> void
+    {
+        auto eps = _mm256_set1_ps(-1e-6f);
+        auto one = _mm256_set1_ps(1.0f);
+        auto lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        for (auto slot = begin; slot < end; slot += 8) {
+            auto valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(end - slot), lane);
+            auto qx = _mm256_maskload_ps(batch.qx.data() + slot, valid);
+            auto qy = _mm256_maskload_ps(batch.qy.data() + slot, valid);
+
+            auto open = _mm256_castsi256_ps(valid);
+            auto found = _mm256_set1_epi32(-1);
+            auto w0 = _mm256_setzero_ps();
+            auto w1 = _mm256_setzero_ps();
+            for (auto i = grid.cell_start[cell]; i < grid.cell_start[cell + 1] && _mm256_movemask_ps(open) != 0; i++) {
+                auto t = grid.cell_triangles[i];
+                auto& frame = frames[t];
+                if (frame.degenerate)
+                    continue;
+                auto dx = _mm256_sub_ps(qx, _mm256_set1_ps(frame.origin.x));
+                auto dy = _mm256_sub_ps(qy, _mm256_set1_ps(frame.origin.y));
+                // inverse is column major, w = inverse * d
+                auto a = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frame.inverse[0][0]), dx), _mm256_mul_ps(_mm256_set1_ps(frame.inverse[1][0]), dy));
+                auto b = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(frame.inverse[0][1]), dx), _mm256_mul_ps(_mm256_set1_ps(frame.inverse[1][1]), dy));
+                auto c = _mm256_sub_ps(_mm256_sub_ps(one, a), b);
+
+                auto inside = _mm256_and_ps(_mm256_cmp_ps(a, eps, _CMP_GE_OQ), _mm256_cmp_ps(b, eps, _CMP_GE_OQ));
+                inside = _mm256_and_ps(_mm256_and_ps(inside, _mm256_cmp_ps(c, eps, _CMP_GE_OQ)), open);
+
+                found = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(found), _mm256_castsi256_ps(_mm256_set1_epi32(t)), inside));
+                w0 = _mm256_blendv_ps(w0, a, inside);
+                w1 = _mm256_blendv_ps(w1, b, inside);
+                open = _mm256_andnot_ps(inside, open);
+            }
+
+            alignas(32) int triangle[8];
+            alignas(32) float weight0[8];
+            alignas(32) float weight1[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(triangle), found);
+            _mm256_store_ps(weight0, w0);
+            _mm256_store_ps(weight1, w1);
+            for (auto k = 0; k < 8 && slot + k < end; k++) {
+                batch.sorted_triangle[slot + k] = triangle[k];
+                if (triangle[k] >= 0)
+                    batch.sorted_weight[slot + k] = {weight0[k], weight1[k], 1.0f - weight0[k] - weight1[k]};
+            }
+        }
+    }
+#else
+    auto Blend_Space_2D::resolve_cell_simd(int cell, Blend_Batch& batch, int begin, int end) const -> void
+    {
+        resolve_cell(cell, batch, begin, end);
+    }
+#endif
+} // namespace Blendspace2D
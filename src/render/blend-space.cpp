@@ -0,0 +1,461 @@
+#include "blend-space.hpp"
+#include "delaunay.hpp"
+#include "render/cmake-source-dir.hpp"
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+
+namespace Blendspace
+{
+    auto advance_frames(assimp_model::Model& model, std::vector<int>& frame_ids, float& left_weight, float& right_weight) -> void
+    {
+        if (right_weight < 1.0f)
+            return;
+        for (auto i = 0; i < frame_ids.size(); i++) {
+            frame_ids[i]++;
+            if (frame_ids[i] >= model.tracks[i].duration - 1) {
+                frame_ids[i] = 0;
+            }
+        }
+        left_weight = 1.0f;
+        right_weight = 0.0f;
+    }
+
+    template <>
+    auto build_simplices<1>(const std::vector<Point<1>>& points) -> std::vector<Simplex<1>>
+    {
+        auto order = std::vector<int>(points.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+            return points[a].x < points[b].x;
+        });
+        order.erase(std::unique(order.begin(), order.end(), [&](int a, int b) {
+            return points[a].x == points[b].x;
+        }), order.end());
+
+        // interval i spans the i-th and i+1-th smallest nodes, so neighbors are i +- 1
+        auto simplices = std::vector<Simplex<1>>{};
+        for (auto i = 0; i + 1 < order.size(); i++) {
+            auto& s = simplices.emplace_back();
+            s.corners = {order[i], order[i + 1]};
+            s.neighbors = {i + 2 < order.size() ? i + 1 : -1, i - 1};
+        }
+        return simplices;
+    }
+
+    template <>
+    auto build_simplices<2>(const std::vector<Point<2>>& points) -> std::vector<Simplex<2>>
+    {
+        auto delaunay = Blendspace2D::Delaunay{};
+        delaunay.build(points);
+
+        auto simplices = std::vector<Simplex<2>>(delaunay.triangles.size());
+        for (auto t = 0; t < simplices.size(); t++) {
+            auto& v = delaunay.triangles[t];
+            auto& n = delaunay.neighbors[t];
+            simplices[t].corners = {v.x, v.y, v.z};
+            simplices[t].neighbors = {n.x, n.y, n.z};
+        }
+        return simplices;
+    }
+
+    // Bowyer-Watson in 3D. Nodes are mapped to the unit box first, so axes in different units (speed
+    // against slope) meet the same tolerances, and tolerances scale with the terms they compare. The
+    // four outer corners are symbolic, infinitely far away in regular tetrahedron directions: a sphere
+    // through one of them is the half-space beyond the plane of the other corners, so no node can fall
+    // into a far corner's cavity and every node ends up in a mesh covering the hull. 3D blend spaces
+    // hold tens of nodes, so the tetrahedron holding a new node is found by a scan; its cavity is grown
+    // through neighbors from there.
+    template <>
+    auto build_simplices<3>(const std::vector<Point<3>>& input) -> std::vector<Simplex<3>>
+    {
+        using Tet = std::array<int, 4>;
+        constexpr auto eps = 1e-10;
+        auto point_num = int(input.size());
+        if (point_num < 4)
+            return {};
+
+        auto lo = glm::dvec3(input[0]);
+        auto hi = glm::dvec3(input[0]);
+        for (auto& p: input) {
+            lo = glm::min(lo, glm::dvec3(p));
+            hi = glm::max(hi, glm::dvec3(p));
+        }
+        auto scale = 1.0 / glm::max(hi - lo, glm::dvec3(1e-12));
+        auto points = std::vector<glm::dvec3>{};
+        for (auto& p: input)
+            points.emplace_back((glm::dvec3(p) - lo) * scale);
+
+        // vertex v sits at base(v) + R * direction(v) with R going to infinity, real nodes have no direction
+        const glm::dvec3 directions[4] = {{1.0, 1.0, 1.0}, {1.0, -1.0, -1.0}, {-1.0, 1.0, -1.0}, {-1.0, -1.0, 1.0}};
+        auto base = [&](int v) -> glm::dvec3 {
+            return v < point_num ? points[v] : glm::dvec3{0.5};
+        };
+        auto direction = [&](int v) -> glm::dvec3 {
+            return v < point_num ? glm::dvec3{0.0} : directions[v - point_num];
+        };
+
+        // det[q1 - q0, q2 - q0, q3 - q0], every row is u + R w so the determinant is a cubic in R whose
+        // sign is the sign of its highest coefficient that is not zero; > 0 when q3 lies on the side of
+        // q0 q1 q2 a positive tetrahedron keeps its fourth corner on
+        auto orient = [&](const Tet& q) -> double {
+            glm::dvec3 u[3];
+            glm::dvec3 w[3];
+            for (auto i = 0; i < 3; i++) {
+                u[i] = base(q[i + 1]) - base(q[0]);
+                w[i] = direction(q[i + 1]) - direction(q[0]);
+            }
+            double coefficient[4]{};
+            double bound[4]{};
+            for (auto mask = 0; mask < 8; mask++) {
+                auto rows = glm::dmat3{mask & 1 ? w[0] : u[0], mask & 2 ? w[1] : u[1], mask & 4 ? w[2] : u[2]};
+                auto degree = (mask & 1) + (mask >> 1 & 1) + (mask >> 2 & 1);
+                coefficient[degree] += glm::determinant(rows);
+                bound[degree] += glm::length(rows[0]) * glm::length(rows[1]) * glm::length(rows[2]);
+            }
+            for (auto degree = 3; degree >= 0; degree--) {
+                if (glm::abs(coefficient[degree]) > eps * bound[degree])
+                    return coefficient[degree];
+            }
+            return 0.0;
+        };
+        // corner k of t moved to p, > 0 when p is on the inner side of the face opposite k
+        auto orient_to = [&](const Tet& t, int k, int p) -> double {
+            auto q = t;
+            q[k] = p;
+            return orient(q);
+        };
+
+        // p strictly inside the circumsphere of the positive tetrahedron t
+        auto in_sphere = [&](const Tet& t, int p) -> bool {
+            auto far = std::array<int, 4>{};
+            auto near = std::array<glm::dvec3, 4>{};
+            auto far_num = 0;
+            auto near_num = 0;
+            for (auto k = 0; k < 4; k++) {
+                if (t[k] >= point_num)
+                    far[far_num++] = k;
+                else
+                    near[near_num++] = points[t[k]];
+            }
+            auto x = points[p];
+            if (far_num == 0) {
+                // lifted onto the paraboloid, p is inside when it lies below the plane of the lifted corners
+                glm::dvec4 rows[4];
+                auto bound = 1.0;
+                for (auto k = 0; k < 4; k++) {
+                    auto d = points[t[k]] - x;
+                    rows[k] = glm::dvec4{d, glm::dot(d, d)};
+                    bound *= glm::length(rows[k]);
+                }
+                return -glm::determinant(glm::dmat4{rows[0], rows[1], rows[2], rows[3]}) > eps * bound;
+            }
+            if (far_num == 1)
+                return orient_to(t, far[0], p) > 0.0;
+            if (far_num == 4)
+                return true;
+
+            // two or three far corners: the plane through the near ones that runs along the far ones' face
+            auto d0 = direction(t[far[0]]);
+            auto d1 = direction(t[far[1]]) - d0;
+            auto normal = far_num == 2 ? glm::cross(near[1] - near[0], d1) : glm::cross(d1, direction(t[far[2]]) - d0);
+            auto side = glm::dot(normal, d0);
+            auto offset = x - near[0];
+            return side * glm::dot(normal, offset) > eps * glm::abs(side) * glm::length(normal) * glm::length(offset);
+        };
+
+        auto tets = std::vector<Tet>{{point_num, point_num + 1, point_num + 2, point_num + 3}};
+        auto neighbors = std::vector<Tet>{{-1, -1, -1, -1}};
+        auto alive = std::vector<bool>{true};
+        if (orient(tets[0]) < 0.0)
+            std::swap(tets[0][0], tets[0][1]);
+
+        auto in_cavity = std::vector<int>(1, -1);
+        for (auto i = 0; i < point_num; i++) {
+            if (std::find(points.begin(), points.begin() + i, points[i]) != points.begin() + i)
+                continue;
+
+            // every tetrahedron holding p, several when p lies on a face or an edge; they always stay in the cavity
+            auto cavity = std::vector<int>{};
+            auto pinned = std::vector<int>{};
+            for (auto t = 0; t < tets.size(); t++) {
+                if (!alive[t])
+                    continue;
+                auto inside = true;
+                for (auto k = 0; k < 4 && inside; k++)
+                    inside = orient_to(tets[t], k, i) >= 0.0;
+                if (inside) {
+                    pinned.emplace_back(t);
+                    cavity.emplace_back(t);
+                    in_cavity[t] = i;
+                }
+            }
+
+            // grown through neighbors, so the cavity stays connected
+            for (auto c = 0; c < cavity.size(); c++) {
+                for (auto n: neighbors[cavity[c]]) {
+                    if (n < 0 || in_cavity[n] == i || !in_sphere(tets[n], i))
+                        continue;
+                    in_cavity[n] = i;
+                    cavity.emplace_back(n);
+                }
+            }
+
+            // every boundary face has to see p from the inside, or the new tetrahedra would fold over;
+            // near cospherical nodes can break that, such tetrahedra leave the cavity again
+            for (auto changed = true; changed;) {
+                changed = false;
+                for (auto c = 0; c < cavity.size() && !changed; c++) {
+                    auto t = cavity[c];
+                    if (std::find(pinned.begin(), pinned.end(), t) != pinned.end())
+                        continue;
+                    for (auto k = 0; k < 4 && !changed; k++) {
+                        auto n = neighbors[t][k];
+                        if ((n >= 0 && in_cavity[n] == i) || orient_to(tets[t], k, i) > 0.0)
+                            continue;
+                        in_cavity[t] = -1;
+                        cavity.erase(cavity.begin() + c);
+                        changed = true;
+                    }
+                }
+            }
+
+            // one new tetrahedron per boundary face, p takes the place of the corner across it
+            auto open_faces = std::map<std::array<int, 3>, glm::ivec2>{};
+            for (auto t: cavity) {
+                for (auto k = 0; k < 4; k++) {
+                    auto n = neighbors[t][k];
+                    if (n >= 0 && in_cavity[n] == i)
+                        continue;
+                    auto created = int(tets.size());
+                    auto tet = tets[t];
+                    tet[k] = i;
+                    tets.emplace_back(tet);
+                    neighbors.emplace_back(Tet{-1, -1, -1, -1});
+                    alive.emplace_back(true);
+                    in_cavity.emplace_back(-1);
+                    neighbors[created][k] = n;
+                    if (n >= 0) {
+                        for (auto& across: neighbors[n]) {
+                            if (across == t)
+                                across = created;
+                        }
+                    }
+                    // the three faces through p pair up with the other new tetrahedra
+                    for (auto m = 0; m < 4; m++) {
+                        if (m == k)
+                            continue;
+                        auto face = std::array<int, 3>{};
+                        for (auto j = 0, f = 0; j < 4; j++) {
+                            if (j != m)
+                                face[f++] = tet[j];
+                        }
+                        std::sort(face.begin(), face.end());
+                        auto other = open_faces.find(face);
+                        if (other == open_faces.end()) {
+                            open_faces.emplace(face, glm::ivec2{created, m});
+                        } else {
+                            neighbors[created][m] = other->second.x;
+                            neighbors[other->second.x][other->second.y] = created;
+                            open_faces.erase(other);
+                        }
+                    }
+                }
+            }
+            for (auto t: cavity)
+                alive[t] = false;
+        }
+
+        auto simplices = std::vector<Simplex<3>>{};
+        for (auto t = 0; t < tets.size(); t++) {
+            if (alive[t] && std::all_of(tets[t].begin(), tets[t].end(), [&](int c) { return c < point_num; }))
+                simplices.emplace_back().corners = tets[t];
+        }
+
+        // two tetrahedra are neighbors when they share a face
+        auto open_faces = std::map<std::array<int, 3>, glm::ivec2>{};
+        for (auto s = 0; s < simplices.size(); s++) {
+            simplices[s].neighbors.fill(-1);
+            for (auto k = 0; k < 4; k++) {
+                auto& c = simplices[s].corners;
+                auto face = std::array<int, 3>{c[(k + 1) % 4], c[(k + 2) % 4], c[(k + 3) % 4]};
+                std::sort(face.begin(), face.end());
+                auto other = open_faces.find(face);
+                if (other == open_faces.end()) {
+                    open_faces.emplace(face, glm::ivec2{s, k});
+                } else {
+                    simplices[s].neighbors[k] = other->second.x;
+                    simplices[other->second.x].neighbors[other->second.y] = s;
+                    open_faces.erase(other);
+                }
+            }
+        }
+
+        // the open faces close around the hull, so the tetrahedra have to fill exactly what they enclose;
+        // more means some overlap
+        auto volume = 0.0;
+        auto enclosed = 0.0;
+        for (auto& s: simplices) {
+            auto& c = s.corners;
+            volume += glm::abs(orient(c)) / 6.0;
+            for (auto k = 0; k < 4; k++) {
+                if (s.neighbors[k] >= 0)
+                    continue;
+                auto& a = points[c[(k + 1) % 4]];
+                auto normal = glm::cross(points[c[(k + 2) % 4]] - a, points[c[(k + 3) % 4]] - a);
+                if (glm::dot(normal, points[c[k]] - a) > 0.0)
+                    normal = -normal;
+                enclosed += glm::dot(a, normal) / 6.0;
+            }
+        }
+        if (glm::abs(volume - enclosed) > 1e-6 * glm::max(enclosed, 1e-12))
+            std::cout << std::format("3d blend space: tetrahedra fill {:.6f} of a {:.6f} hull (unit box), they overlap\n", volume, enclosed);
+        return simplices;
+    }
+
+    template <int D>
+    auto Blend_Space<D>::init(assimp_model::Model& model, const std::string path) -> void
+    {
+        frame_ids.resize(model.tracks.size(), 0);
+
+        std::ifstream config_fs(ROOT_DIR + path);
+        auto config = nlohmann::json::parse(config_fs, nullptr, true, true);
+
+        constexpr const char* axes[] = {"x", "y", "z"};
+        auto points = std::vector<Point<D>>{};
+        auto tracks = std::vector<int>{};
+        for (auto& node: config.find("node").value()) {
+            auto& p = points.emplace_back();
+            for (auto k = 0; k < D; k++)
+                p[k] = node.find(axes[k]).value();
+            tracks.emplace_back(node.find("anim_id").value());
+        }
+        build(points, tracks);
+        std::cout << std::format("{:d}d blend space {:d} nodes, {:d} simplices\n", D, nodes.size(), simplices.size());
+    }
+
+    template <int D>
+    auto Blend_Space<D>::build(const std::vector<Point<D>>& points, const std::vector<int>& tracks) -> void
+    {
+        nodes = points;
+        node_tracks = tracks;
+        simplices = build_simplices<D>(points);
+        last_simplex = -1;
+
+        for (auto& s: simplices) {
+            s.origin = nodes[s.corners[D]];
+            auto edges = Matrix<D>{};
+            if constexpr (D == 1) {
+                edges = nodes[s.corners[0]].x - s.origin.x;
+                s.degenerate = glm::abs(edges) < 1e-12f;
+                if (!s.degenerate)
+                    s.inverse = 1.0f / edges;
+            } else {
+                for (auto k = 0; k < D; k++)
+                    edges[k] = nodes[s.corners[k]] - s.origin;
+                s.degenerate = glm::abs(glm::determinant(edges)) < 1e-12f;
+                if (!s.degenerate)
+                    s.inverse = glm::inverse(edges);
+            }
+        }
+
+        // until the first sample lands, blend the first node alone
+        current.track_ids.assign(D + 1, tracks.empty() ? 0 : tracks.front());
+        current.weights.assign(D + 1, 0.0f);
+        current.weights[0] = 1.0f;
+    }
+
+    template <int D>
+    auto Blend_Space<D>::locate(const Point<D>& p, int hint) const -> int
+    {
+        constexpr auto eps = -1e-6f;
+        if (simplices.empty())
+            return -1;
+
+        auto q = p;
+        if constexpr (D == 1) {
+            // below the slowest or above the fastest node plays that node
+            auto [lo, hi] = std::minmax_element(nodes.begin(), nodes.end(), [](auto& a, auto& b) { return a.x < b.x; });
+            q.x = glm::clamp(q.x, lo->x, hi->x);
+        }
+
+        // step through the face opposite the most negative weight
+        auto s = hint;
+        for (auto step = 0; s >= 0 && step < max_walk; step++) {
+            if (simplices[s].degenerate)
+                break;
+            auto w = simplices[s].weight(q);
+            auto k = int(std::min_element(w.begin(), w.end()) - w.begin());
+            if (w[k] >= eps)
+                return s;
+            s = simplices[s].neighbors[k];
+        }
+
+        if constexpr (D == 1) {
+            // intervals are sorted by their left node
+            auto found = std::partition_point(simplices.begin(), simplices.end(), [&](auto& interval) {
+                return nodes[interval.corners[1]].x < q.x;
+            });
+            return found == simplices.end() ? int(simplices.size()) - 1 : int(found - simplices.begin());
+        } else {
+            for (auto candidate = 0; candidate < simplices.size(); candidate++) {
+                if (simplices[candidate].degenerate)
+                    continue;
+                auto w = simplices[candidate].weight(q);
+                if (*std::min_element(w.begin(), w.end()) >= eps)
+                    return candidate;
+            }
+            return -1;
+        }
+    }
+
+    template <int D>
+    auto Blend_Space<D>::sample(const Point<D>& p, int hint, Blend_Weights& out) const -> bool
+    {
+        auto s = locate(p, hint);
+        if (s < 0)
+            return false;
+        weigh(p, s, out);
+        return true;
+    }
+
+    template <int D>
+    auto Blend_Space<D>::weigh(const Point<D>& p, int s, Blend_Weights& out) const -> void
+    {
+        auto q = p;
+        if constexpr (D == 1)
+            q.x = glm::clamp(q.x, glm::min(nodes[simplices[s].corners[0]].x, nodes[simplices[s].corners[1]].x), glm::max(nodes[simplices[s].corners[0]].x, nodes[simplices[s].corners[1]].x));
+        auto w = simplices[s].weight(q);
+        out.track_ids.resize(D + 1);
+        out.weights.resize(D + 1);
+        for (auto k = 0; k <= D; k++) {
+            out.track_ids[k] = node_tracks[simplices[s].corners[k]];
+            out.weights[k] = glm::max(w[k], 0.0f);
+        }
+    }
+
+    template <int D>
+    auto Blend_Space<D>::update(assimp_model::Model& model, const Point<D>& p, float& left_weight, float& right_weight) -> void
+    {
+        advance_frames(model, frame_ids, left_weight, right_weight);
+
+        auto s = locate(p, last_simplex);
+        if (s >= 0) {
+            weigh(p, s, current);
+            last_simplex = s;
+            position = p;
+        }
+
+        model.blend_tracks(frame_ids, current.track_ids, left_weight, right_weight, current.weights);
+        model.bind_textures();
+    }
+
+    template struct Blend_Space<1>;
+    template struct Blend_Space<2>;
+    template struct Blend_Space<3>;
+} // namespace Blendspace
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <glm/glm.hpp>
+#include <array>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Blendspace
+{
+    // What every blend space hands the pose blender (Model::blend_tracks): one track and one weight per
+    // corner of the simplex holding the blend parameter, weights sum to one.
+    struct Blend_Weights final
+    {
+        std::vector<int> track_ids{};
+        std::vector<float> weights{};
+    };
+
+    // steps every track one frame once the pose blender has reached the right frame
+    auto advance_frames(assimp_model::Model& model, std::vector<int>& frame_ids, float& left_weight, float& right_weight) -> void;
+
+    template <int D>
+    using Point = glm::vec<D, float>;
+
+    // glm has no 1x1 matrix, an interval inverts with a float
+    template <int D>
+    using Matrix = std::conditional_t<D == 1, float, glm::mat<D, D, float>>;
+
+    // Interval, triangle or tetrahedron. Weights of corners 0 .. D-1 are inverse * (p - origin) with
+    // origin at corner D, which gets the rest.
+    template <int D>
+    struct Simplex final
+    {
+        std::array<int, D + 1> corners{};
+        // across the face opposite each corner, -1 on the hull
+        std::array<int, D + 1> neighbors{};
+        Point<D> origin{};
+        Matrix<D> inverse{0.0f};
+        bool degenerate{true};
+
+        auto weight(const Point<D>& p) const -> std::array<float, D + 1>
+        {
+            auto w = inverse * (p - origin);
+            auto weights = std::array<float, D + 1>{};
+            weights[D] = 1.0f;
+            for (auto k = 0; k < D; k++) {
+                weights[k] = w[k];
+                weights[D] -= w[k];
+            }
+            return weights;
+        }
+    };
+
+    // sorted intervals for D = 1, Delaunay triangles for D = 2, Delaunay tetrahedra for D = 3;
+    // corners and neighbors are filled, frames are left to the blend space
+    template <int D>
+    auto build_simplices(const std::vector<Point<D>>& points) -> std::vector<Simplex<D>>;
+
+    // Blend space over D parameters, e.g. speed; speed and direction; speed, direction and slope.
+    // Blendspace2D::Blend_Space_2D stays the 2D editor with its grid locator and baked weights, and
+    // fills the same Blend_Weights.
+    template <int D>
+    struct Blend_Space final
+    {
+        std::vector<Point<D>> nodes{};
+        std::vector<int> node_tracks{};
+        std::vector<Simplex<D>> simplices{};
+
+        std::vector<int> frame_ids{};
+        Blend_Weights current{};
+        Point<D> position{};
+
+        // where the previous sample was found, the next walk starts here
+        int last_simplex{-1};
+
+        // a walk longer than this is a jump
+        static constexpr int max_walk = 8;
+
+        // "node" entries with x (y, z as D needs) and anim_id, like blend-space.json
+        auto init(assimp_model::Model& model, const std::string path) -> void;
+
+        auto build(const std::vector<Point<D>>& points, const std::vector<int>& tracks) -> void;
+
+        // -1 outside; a 1D space clamps to its end nodes instead
+        auto locate(const Point<D>& p, int hint) const -> int;
+
+        // false leaves out untouched
+        auto sample(const Point<D>& p, int hint, Blend_Weights& out) const -> bool;
+
+        // the weighing half of sample, for callers that already located p in simplex
+        auto weigh(const Point<D>& p, int simplex, Blend_Weights& out) const -> void;
+
+        auto update(assimp_model::Model& model, const Point<D>& p, float& left_weight, float& right_weight) -> void;
+    };
+
+    using Blend_Space_1D = Blend_Space<1>;
+    using Blend_Space_3D = Blend_Space<3>;
+} // namespace Blendspace
@@ -0,0 +1,129 @@
+#include "compute-tuner.hpp"
+#include "gpu-timer.hpp"
+
+#include <bit>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+
+namespace render
+{
+    auto Compute_Tuner::init(const std::string& path) -> void
+    {
+        cache_path = path;
+        auto gl_string = [](GLenum name) -> std::string {
+            auto text = reinterpret_cast<const char*>(glGetString(name));
+            return text != nullptr ? text : "";
+        };
+        device = gl_string(GL_VENDOR) + " / " + gl_string(GL_RENDERER) + " / " + gl_string(GL_VERSION);
+
+        glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &max_invocations);
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &max_size_x);
+        glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &max_group_count_x);
+        glGetIntegerv(GL_MAX_COMPUTE_SHARED_MEMORY_SIZE, &max_shared_memory);
+
+        std::ifstream cfs(cache_path);
+        if (cfs) {
+            cache = nlohmann::json::parse(cfs, nullptr, false, true);
+            if (!cache.is_object())
+                cache = nlohmann::json::object();
+        }
+    }
+
+    auto Compute_Tuner::cache_file(const std::string& name) -> std::string
+    {
+        // XDG_CACHE_HOME, ~/.cache or %LOCALAPPDATA%, whichever is set first
+        auto directory = std::filesystem::path{};
+        if (auto xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0')
+            directory = xdg;
+        else if (auto home = std::getenv("HOME"); home != nullptr && *home != '\0')
+            directory = std::filesystem::path{home} / ".cache";
+        else if (auto local = std::getenv("LOCALAPPDATA"); local != nullptr && *local != '\0')
+            directory = local;
+        else
+            return name;
+
+        directory /= "skeleton-animation";
+        auto error = std::error_code{};
+        std::filesystem::create_directories(directory, error);
+        return error ? name : (directory / name).string();
+    }
+
+    auto Compute_Tuner::save() const -> void
+    {
+        std::ofstream cfs(cache_path);
+        cfs << cache.dump(4) << std::endl;
+    }
+
+    auto Compute_Tuner::lookup(const std::string& pass, int work_size) const -> int
+    {
+        auto entry = cache.find(device);
+        if (entry == cache.end())
+            return 0;
+        auto sizes = entry->find(pass);
+        if (sizes == entry->end())
+            return 0;
+        auto winner = sizes->find(std::to_string(bucket(work_size)));
+        if (winner == sizes->end())
+            return 0;
+        return winner->get<int>();
+    }
+
+    auto Compute_Tuner::tune(const std::string& pass, int work_size, const std::vector<int>& candidates, const std::function<void(int group_size)>& run) -> int
+    {
+        constexpr auto repeats = 5;
+
+        // gpu time of the dispatches only, the wall clock would also count driver work and the glFinish round trip
+        auto timer = Gpu_Timer{};
+        timer.init();
+
+        auto best{0};
+        auto best_ms{0.0f};
+        for (auto group_size: candidates) {
+            if (!fits(work_size, group_size))
+                continue;
+
+            // first dispatch of a program pays for its compile and upload
+            run(group_size);
+
+            if (!timer.begin())
+                continue;
+            for (auto i = 0; i < repeats; i++)
+                run(group_size);
+            timer.end();
+            timer.collect(true);
+            auto ms = timer.elapsed_ms / repeats;
+            std::cout << std::format("compute tuner {:s} {:d} items, group size {:d}: {:.3f} ms\n", pass, work_size, group_size, ms);
+
+            if (best == 0 || ms < best_ms) {
+                best = group_size;
+                best_ms = ms;
+            }
+        }
+        timer.release();
+        if (best == 0)
+            return 0;
+
+        cache[device][pass][std::to_string(bucket(work_size))] = best;
+        save();
+        std::cout << std::format("compute tuner {:s} {:d} items: group size {:d} on {:s}\n", pass, work_size, best, device);
+        return best;
+    }
+
+    auto Compute_Tuner::bucket(int work_size) -> int
+    {
+        return int(std::bit_ceil(unsigned(work_size > 1 ? work_size : 1)));
+    }
+
+    auto Compute_Tuner::shared() -> Compute_Tuner&
+    {
+        static auto tuner = [] {
+            auto t = Compute_Tuner{};
+            t.init(cache_file("compute_tuning.json"));
+            return t;
+        }();
+        return tuner;
+    }
+} // namespace render
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <nlohmann/json.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace render
+{
+    // Picks the workgroup size of a compute pass by timing candidates, one entry per pass and
+    // power of two work size, timed with GL_TIME_ELAPSED queries. Winners are cached per driver
+    // (vendor, renderer, version) in a json file, so a machine only pays for tuning once. A pass opts in by compiling its shader with
+    // GROUP_SIZE as a macro and handing tune() a callback that dispatches one candidate.
+    struct Compute_Tuner final
+    {
+        std::string cache_path{};
+        std::string device{};
+        nlohmann::json cache = nlohmann::json::object();
+
+        GLint max_invocations{};
+        GLint max_size_x{};
+        GLint max_group_count_x{};
+        GLint max_shared_memory{};
+
+        // path is taken as is, not under ROOT_DIR: the cache is per machine and stays out of the source tree
+        auto init(const std::string& path) -> void;
+
+        auto save() const -> void;
+
+        // cached winner, 0 when the pass has not been tuned at this size on this device
+        auto lookup(const std::string& pass, int work_size) const -> int;
+
+        // no other GL_TIME_ELAPSED query may be active around it;
+        // times run(group_size) for every candidate the device can launch as one 1D dispatch,
+        // keeps the fastest in the cache and writes it to disk
+        auto tune(const std::string& pass, int work_size, const std::vector<int>& candidates, const std::function<void(int group_size)>& run) -> int;
+
+        auto fits(int work_size, int group_size) const -> bool
+        {
+            return group_size <= max_invocations && group_size <= max_size_x && group_count(work_size, group_size) <= max_group_count_x;
+        }
+
+        static auto group_count(int work_size, int group_size) -> int
+        {
+            return (work_size + group_size - 1) / group_size;
+        }
+
+        // work sizes share an entry up to the next power of two
+        static auto bucket(int work_size) -> int;
+
+        // name inside the per-user cache directory, created on demand; name alone, relative to the
+        // working directory, when there is no such directory
+        static auto cache_file(const std::string& name) -> std::string;
+
+        // needs a current gl context on first use, caches in cache_file("compute_tuning.json")
+        static auto shared() -> Compute_Tuner&;
+    };
+} // namespace render
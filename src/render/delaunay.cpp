@@ -0,0 +1,428 @@
+#include "delaunay.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+
+namespace Blendspace2D
+{
+    // position along a Hilbert curve over a 2^16 grid, neighbors on the curve are neighbors in the plane
+    static auto hilbert_index(std::uint32_t x, std::uint32_t y) -> std::uint64_t
+    {
+        auto d = std::uint64_t{0};
+        for (auto s = std::uint32_t{1} << 15; s > 0; s >>= 1) {
+            auto rx = (x & s) > 0 ? 1u : 0u;
+            auto ry = (y & s) > 0 ? 1u : 0u;
+            d += std::uint64_t(s) * s * ((3 * rx) ^ ry);
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = s - 1 - (x & (s - 1)) + (x & ~(s - 1));
+                    y = s - 1 - (y & (s - 1)) + (y & ~(s - 1));
+                }
+                std::swap(x, y);
+            }
+        }
+        return d;
+    }
+
+    auto Delaunay::in_circle(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c, const glm::dvec2& d) -> double
+    {
+        auto ad = a - d;
+        auto bd = b - d;
+        auto cd = c - d;
+        return glm::dot(ad, ad) * (bd.x * cd.y - cd.x * bd.y)
+             - glm::dot(bd, bd) * (ad.x * cd.y - cd.x * ad.y)
+             + glm::dot(cd, cd) * (ad.x * bd.y - bd.x * ad.y);
+    }
+
+    // far corner k sits at (0.5, 0.5) + R * far_directions[k] with R going to infinity; equally long,
+    // counter clockwise, so the limits below hold
+    static const glm::dvec2 far_directions[3] = {{0.0, 1.0}, {-0.8660254037844386, -0.5}, {0.8660254037844386, -0.5}};
+
+    auto Delaunay::orient(int a, int b, int c) const -> double
+    {
+        // every difference is u + R w, so the cross product is a quadratic in R whose sign is the sign
+        // of its highest coefficient that is not zero
+        auto direction = [&](int v) -> glm::dvec2 {
+            return v < point_num ? glm::dvec2{0.0} : far_directions[v - point_num];
+        };
+        auto cross = [](const glm::dvec2& u, const glm::dvec2& v) -> double {
+            return u.x * v.y - u.y * v.x;
+        };
+        auto u0 = points[b] - points[a];
+        auto u1 = points[c] - points[a];
+        auto w0 = direction(b) - direction(a);
+        auto w1 = direction(c) - direction(a);
+        const double coefficient[3] = {cross(u0, u1), cross(w0, u1) + cross(u0, w1), cross(w0, w1)};
+        const double bound[3] = {
+            glm::length(u0) * glm::length(u1),
+            glm::length(w0) * glm::length(u1) + glm::length(u0) * glm::length(w1),
+            glm::length(w0) * glm::length(w1),
+        };
+        for (auto degree = 2; degree >= 0; degree--) {
+            if (glm::abs(coefficient[degree]) > 1e-12 * bound[degree])
+                return coefficient[degree];
+        }
+        return 0.0;
+    }
+
+    auto Delaunay::in_circle(int t, int p) const -> bool
+    {
+        auto& v = triangles[t];
+        auto far_num = int(v.x >= point_num) + int(v.y >= point_num) + int(v.z >= point_num);
+        if (far_num == 0)
+            return in_circle(points[v.x], points[v.y], points[v.z], points[p]) > 0.0;
+        if (far_num == 3)
+            return true;
+        for (auto k = 0; k < 3; k++) {
+            auto a = v[k];
+            auto b = v[(k + 1) % 3];
+            auto c = v[(k + 2) % 3];
+            // one far corner c: the circle opens into the half plane left of a b, and takes in the
+            // open edge itself, or a node on a hull edge would leave a flat triangle behind
+            if (far_num == 1 && c >= point_num) {
+                auto side = orient(a, b, p);
+                return side > 0.0 || (side == 0.0 && glm::dot(points[p] - points[a], points[p] - points[b]) < 0.0);
+            }
+            // two far corners b c: the half plane beyond the line through a that runs along b c
+            if (far_num == 2 && a < point_num) {
+                auto along = far_directions[c - point_num] - far_directions[b - point_num];
+                auto offset = points[p] - points[a];
+                return along.x * offset.y - along.y * offset.x < -1e-12 * glm::length(along) * glm::length(offset);
+            }
+        }
+        return false;
+    }
+
+    auto Delaunay::build(const std::vector<glm::vec2>& input) -> void
+    {
+        point_num = int(input.size());
+        points.assign(input.begin(), input.end());
+        triangles.clear();
+        neighbors.clear();
+        cavity_mark.clear();
+        if (point_num < 3)
+            return;
+
+        auto lo = points[0];
+        auto hi = points[0];
+        for (auto& p: points) {
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        auto scale = 1.0 / glm::max(hi - lo, glm::dvec2(1e-12));
+        for (auto& p: points)
+            p = (p - lo) * scale;
+
+        // sort along the curve, duplicates end up next to each other
+        auto order = std::vector<int>(point_num);
+        auto keys = std::vector<std::uint64_t>(point_num);
+        for (auto i = 0; i < point_num; i++) {
+            auto cell = glm::u32vec2(points[i] * 65535.0);
+            keys[i] = hilbert_index(cell.x, cell.y);
+        }
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](int a, int b) {
+            return keys[a] < keys[b] || (keys[a] == keys[b] && a < b);
+        });
+
+        // one triangle around every point, its corners are removed again at the end
+        for (auto k = 0; k < 3; k++)
+            points.emplace_back(0.5, 0.5);
+        triangles.emplace_back(point_num, point_num + 1, point_num + 2);
+        neighbors.emplace_back(-1, -1, -1);
+        cavity_mark.emplace_back(-1);
+
+        auto last = 0;
+        auto inserted = std::vector<glm::dvec2>{};
+        for (auto n = 0; n < point_num; n++) {
+            auto i = order[n];
+            auto duplicate = false;
+            for (auto m = n - 1; m >= 0 && keys[order[m]] == keys[i] && !duplicate; m--)
+                duplicate = points[order[m]] == points[i];
+            if (duplicate)
+                continue;
+            last = insert(i, last);
+        }
+
+        remove_super_triangle();
+        fill_hull();
+        points.resize(point_num);
+    }
+
+    auto Delaunay::locate(int point, int start) const -> int
+    {
+        // visibility walk, acyclic on a Delaunay mesh
+        auto t = start;
+        while (true) {
+            auto& v = triangles[t];
+            auto next = -1;
+            for (auto k = 0; k < 3 && next < 0; k++) {
+                if (orient(v[(k + 1) % 3], v[(k + 2) % 3], point) < 0.0)
+                    next = neighbors[t][k];
+            }
+            if (next < 0)
+                return t;
+            t = next;
+        }
+    }
+
+    auto Delaunay::insert(int point, int start) -> int
+    {
+        auto first = locate(point, start);
+
+        // every triangle whose circumcircle holds p, grown from the one containing it
+        auto cavity = std::vector<int>{first};
+        cavity_mark[first] = point;
+        struct Boundary_Edge final
+        {
+            int a, b, outside;
+        };
+        auto boundary = std::vector<Boundary_Edge>{};
+        for (auto c = 0; c < cavity.size(); c++) {
+            auto t = cavity[c];
+            for (auto k = 0; k < 3; k++) {
+                auto n = neighbors[t][k];
+                if (n >= 0 && cavity_mark[n] == point)
+                    continue;
+                if (n >= 0 && in_circle(n, point)) {
+                    cavity_mark[n] = point;
+                    cavity.emplace_back(n);
+                } else {
+                    boundary.push_back({triangles[t][(k + 1) % 3], triangles[t][(k + 2) % 3], n});
+                }
+            }
+        }
+
+        // fan from p over the cavity boundary, cavity slots are reused first
+        auto created = std::vector<int>(boundary.size());
+        for (auto e = 0; e < boundary.size(); e++) {
+            if (e < cavity.size()) {
+                created[e] = cavity[e];
+            } else {
+                created[e] = int(triangles.size());
+                triangles.emplace_back();
+                neighbors.emplace_back();
+                cavity_mark.emplace_back(-1);
+            }
+        }
+        for (auto e = 0; e < boundary.size(); e++) {
+            auto& [a, b, outside] = boundary[e];
+            auto t = created[e];
+            triangles[t] = {point, a, b};
+            neighbors[t] = {outside, -1, -1};
+            if (outside >= 0) {
+                auto& o = triangles[outside];
+                for (auto k = 0; k < 3; k++) {
+                    if (o[(k + 1) % 3] == b && o[(k + 2) % 3] == a)
+                        neighbors[outside][k] = t;
+                }
+            }
+        }
+        // (p, a, b) and (p, b, c) share the edge p-b
+        for (auto e = 0; e < boundary.size(); e++) {
+            for (auto f = 0; f < boundary.size(); f++) {
+                if (boundary[e].b == boundary[f].a) {
+                    neighbors[created[e]][1] = created[f];
+                    neighbors[created[f]][2] = created[e];
+                }
+            }
+        }
+        return created.front();
+    }
+
+    auto Delaunay::flip(int t, int k) -> void
+    {
+        // t = (a, b, c) and u = (d, c, b) become (a, b, d) and (a, d, c)
+        auto u = neighbors[t][k];
+        auto a = triangles[t][k];
+        auto b = triangles[t][(k + 1) % 3];
+        auto c = triangles[t][(k + 2) % 3];
+        auto j = 0;
+        while (triangles[u][(j + 1) % 3] != c || triangles[u][(j + 2) % 3] != b)
+            j++;
+        auto d = triangles[u][j];
+
+        auto across_ca = neighbors[t][(k + 1) % 3];
+        auto across_ab = neighbors[t][(k + 2) % 3];
+        auto across_bd = neighbors[u][(j + 1) % 3];
+        auto across_dc = neighbors[u][(j + 2) % 3];
+
+        triangles[t] = {a, b, d};
+        neighbors[t] = {across_bd, u, across_ab};
+        triangles[u] = {a, d, c};
+        neighbors[u] = {across_dc, across_ca, t};
+
+        auto repoint = [&](int n, int from, int to) -> void {
+            if (n < 0)
+                return;
+            for (auto m = 0; m < 3; m++) {
+                if (neighbors[n][m] == from)
+                    neighbors[n][m] = to;
+            }
+        };
+        repoint(across_bd, u, t);
+        repoint(across_ca, t, u);
+    }
+
+    auto Delaunay::legalize(std::vector<glm::ivec2>& edges) -> void
+    {
+        // Lawson flips until every listed edge and every edge a flip exposed is locally Delaunay
+        while (!edges.empty()) {
+            auto t = edges.back().x;
+            auto k = edges.back().y;
+            edges.pop_back();
+            auto u = neighbors[t][k];
+            if (u < 0)
+                continue;
+            auto& v = triangles[t];
+            auto& w = triangles[u];
+            auto d = w.x + w.y + w.z - v[(k + 1) % 3] - v[(k + 2) % 3];
+            if (in_circle(points[v.x], points[v.y], points[v.z], points[d]) <= 1e-12)
+                continue;
+            flip(t, k);
+            edges.emplace_back(t, 0);
+            edges.emplace_back(t, 2);
+            edges.emplace_back(u, 0);
+            edges.emplace_back(u, 1);
+        }
+    }
+
+    auto Delaunay::remove_super_triangle() -> void
+    {
+        auto remap = std::vector<int>(triangles.size(), -1);
+        auto kept = 0;
+        for (auto t = 0; t < triangles.size(); t++) {
+            auto& v = triangles[t];
+            if (v.x < point_num && v.y < point_num && v.z < point_num)
+                remap[t] = kept++;
+        }
+        for (auto t = 0; t < triangles.size(); t++) {
+            if (remap[t] < 0)
+                continue;
+            triangles[remap[t]] = triangles[t];
+            auto n = neighbors[t];
+            for (auto k = 0; k < 3; k++)
+                neighbors[remap[t]][k] = n[k] >= 0 ? remap[n[k]] : -1;
+        }
+        triangles.resize(kept);
+        neighbors.resize(kept);
+        cavity_mark.clear();
+    }
+
+    auto Delaunay::fill_hull() -> void
+    {
+        // With the far corners taken in the limit the boundary is the convex hull; roundoff on nearly
+        // collinear hull nodes can still leave a reflex notch. Walk the boundary counter clockwise and
+        // close every right turn.
+        struct Boundary_Vertex final
+        {
+            int next{-1};
+            int prev{-1};
+            // triangle and corner whose opposite edge runs from this vertex to next
+            glm::ivec2 edge{-1};
+        };
+        auto boundary = std::unordered_map<int, Boundary_Vertex>{};
+        for (auto t = 0; t < triangles.size(); t++) {
+            for (auto k = 0; k < 3; k++) {
+                if (neighbors[t][k] >= 0)
+                    continue;
+                auto a = triangles[t][(k + 1) % 3];
+                auto b = triangles[t][(k + 2) % 3];
+                boundary[a].next = b;
+                boundary[a].edge = {t, k};
+                boundary[b].prev = a;
+            }
+        }
+
+        auto pending = std::vector<int>{};
+        for (auto& [v, _]: boundary)
+            pending.emplace_back(v);
+        auto fixes = std::vector<glm::ivec2>{};
+        while (!pending.empty()) {
+            auto b = pending.back();
+            pending.pop_back();
+            auto found = boundary.find(b);
+            if (found == boundary.end() || found->second.prev < 0 || found->second.next < 0)
+                continue;
+            auto a = found->second.prev;
+            auto c = found->second.next;
+            if (a == c || orient(points[a], points[b], points[c]) >= 0.0)
+                continue;
+
+            // (a, c, b) sits outside the edges a-b and b-c
+            auto t = int(triangles.size());
+            auto ab = boundary[a].edge;
+            auto bc = boundary[b].edge;
+            triangles.emplace_back(a, c, b);
+            neighbors.emplace_back(bc.x, ab.x, -1);
+            neighbors[ab.x][ab.y] = t;
+            neighbors[bc.x][bc.y] = t;
+
+            boundary[a].next = c;
+            boundary[a].edge = {t, 2};
+            boundary[c].prev = a;
+            boundary.erase(b);
+            pending.emplace_back(a);
+            pending.emplace_back(c);
+            fixes.emplace_back(t, 0);
+            fixes.emplace_back(t, 1);
+        }
+        legalize(fixes);
+    }
+
+    // area of the convex hull, monotone chain
+    static auto hull_area(std::vector<glm::dvec2> points) -> double
+    {
+        std::sort(points.begin(), points.end(), [](auto& a, auto& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+        auto hull = std::vector<glm::dvec2>{};
+        for (auto pass = 0; pass < 2; pass++) {
+            auto start = hull.size();
+            for (auto& p: points) {
+                while (hull.size() >= start + 2 && Delaunay::orient(hull[hull.size() - 2], hull.back(), p) <= 0.0)
+                    hull.pop_back();
+                hull.emplace_back(p);
+            }
+            hull.pop_back();
+            std::reverse(points.begin(), points.end());
+        }
+        auto area = 0.0;
+        for (auto i = 0; i < hull.size(); i++)
+            area += Delaunay::orient(glm::dvec2{0.0}, hull[i], hull[(i + 1) % hull.size()]);
+        return area * 0.5;
+    }
+
+    auto benchmark_delaunay(const std::vector<int>& sizes, float aspect) -> std::vector<Delaunay_Sample>
+    {
+        auto samples = std::vector<Delaunay_Sample>{};
+        for (auto size: sizes) {
+            auto rng = std::mt19937{1};
+            auto distribution = std::uniform_real_distribution<float>(-1.0f, 1.0f);
+            auto input = std::vector<glm::vec2>(size);
+            for (auto& p: input)
+                p = {distribution(rng) * aspect, distribution(rng)};
+
+            auto delaunay = Delaunay{};
+            auto start = std::chrono::high_resolution_clock::now();
+            delaunay.build(input);
+            auto ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+            // in input units, the unit box mapping does not keep areas
+            auto points = std::vector<glm::dvec2>(input.begin(), input.end());
+            auto used = std::vector<bool>(size, false);
+            auto area = 0.0;
+            for (auto& t: delaunay.triangles) {
+                area += 0.5 * Delaunay::orient(points[t.x], points[t.y], points[t.z]);
+                used[t.x] = used[t.y] = used[t.z] = true;
+            }
+            auto sample = Delaunay_Sample{size, int(delaunay.triangles.size()), ms, aspect};
+            sample.dropped_nodes = int(std::count(used.begin(), used.end(), false));
+            sample.hull_coverage = float(area / glm::max(hull_area(points), 1e-30));
+            samples.push_back(sample);
+        }
+        return samples;
+    }
+} // namespace Blendspace2D
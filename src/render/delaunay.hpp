@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace Blendspace2D
+{
+    // Incremental Delaunay triangulation (Bowyer-Watson on an adjacency mesh). Points are inserted
+    // along a Hilbert curve, each one is located by walking from the previous insertion and its cavity
+    // is grown through neighbors, so a build is close to O(n log n) instead of testing every triangle.
+    // The input is triangulated in the unit box of its bounds, so axes in different units (speed
+    // against angle) weigh the same, and the three outer corners are symbolic points infinitely far
+    // away, so a thin circumcircle can never reach one and every distinct node stays in the mesh.
+    struct Delaunay final
+    {
+        // the input mapped to the unit box, then the three far corners
+        std::vector<glm::dvec2> points{};
+
+        int point_num{};
+
+        // counter clockwise corner ids into points
+        std::vector<glm::ivec3> triangles{};
+
+        // neighbors[t][k] is the triangle across the edge opposite corner k, -1 on the hull
+        std::vector<glm::ivec3> neighbors{};
+
+        // duplicate positions are dropped, ids still refer to the input order
+        auto build(const std::vector<glm::vec2>& input) -> void;
+
+        static auto orient(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c) -> double
+        {
+            return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        }
+
+        // > 0 when d is strictly inside the circumcircle of the counter clockwise triangle a b c
+        static auto in_circle(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c, const glm::dvec2& d) -> double;
+
+        // orient on point ids, far corners taken in the limit
+        auto orient(int a, int b, int c) const -> double;
+
+        // point p strictly inside the circumcircle of triangle t, far corners taken in the limit
+        auto in_circle(int t, int p) const -> bool;
+
+        // insertion that last visited each triangle, marks the cavity without clearing
+        std::vector<int> cavity_mark{};
+
+        auto locate(int point, int start) const -> int;
+
+        auto insert(int point, int start) -> int;
+
+        auto flip(int t, int k) -> void;
+
+        auto legalize(std::vector<glm::ivec2>& edges) -> void;
+
+        auto remove_super_triangle() -> void;
+
+        auto fill_hull() -> void;
+    };
+
+    struct Delaunay_Sample final
+    {
+        int node_num{};
+        int triangle_num{};
+        float build_ms{};
+        // x range over y range of the nodes
+        float aspect{1.0f};
+        // nodes missing from the mesh and mesh area over hull area, 0 and 1 when the build is right
+        int dropped_nodes{};
+        float hull_coverage{};
+    };
+
+    // uniform random nodes in a rectangle of the given aspect, seeded so runs compare
+    auto benchmark_delaunay(const std::vector<int>& sizes, float aspect = 1.0f) -> std::vector<Delaunay_Sample>;
+} // namespace Blendspace2D
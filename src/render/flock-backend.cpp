@@ -0,0 +1,71 @@
+#include "flock-backend.hpp"
+#include "group-animation.hpp"
+
+#include <cmath>
+
+namespace Group_Animation
+{
+    auto Scalar_Cpu_Backend::step(Flock& flock, float delta_time) -> void
+    {
+        flock.step_cpu(delta_time, kernel, single_thread);
+    }
+
+    auto Threaded_Cpu_Backend::step(Flock& flock, float delta_time) -> void
+    {
+        flock.step_cpu(delta_time, kernel, worker_pool != nullptr ? *worker_pool : Parallel::Worker_Pool::shared());
+    }
+
+    auto Simd_Cpu_Backend::step(Flock& flock, float delta_time) -> void
+    {
+        flock.step_cpu(delta_time, kernel, worker_pool != nullptr ? *worker_pool : Parallel::Worker_Pool::shared());
+    }
+
+    auto Gpu_Backend::step(Flock& flock, float delta_time) -> void
+    {
+        flock.step_gpu(delta_time);
+    }
+
+    auto Backend_Calibration::fastest(int size_index) const -> int
+    {
+        auto best{0};
+        for (auto b = 1; b < steps_per_second.size(); b++) {
+            if (steps_per_second[b][size_index] > steps_per_second[best][size_index])
+                best = b;
+        }
+        return best;
+    }
+
+    auto Backend_Calibration::find_crossovers() -> void
+    {
+        crossovers.clear();
+        for (auto k = 0; k + 1 < sizes.size(); k++) {
+            auto from = fastest(k);
+            auto to = fastest(k + 1);
+            if (from == to)
+                continue;
+
+            auto& a = steps_per_second[from];
+            auto& b = steps_per_second[to];
+            auto boid_num = sizes[k + 1];
+            if (a[k] > 0.0f && a[k + 1] > 0.0f && b[k] > 0.0f && b[k + 1] > 0.0f) {
+                auto lead = std::log(a[k] / b[k]);
+                auto lag = std::log(a[k + 1] / b[k + 1]);
+                auto t = lead / (lead - lag);
+                boid_num = int(std::exp(std::log(float(sizes[k])) + t * std::log(float(sizes[k + 1]) / sizes[k])));
+            }
+            crossovers.emplace_back(boid_num, from, to);
+        }
+    }
+
+    auto Backend_Calibration::choose(int boid_num) const -> int
+    {
+        if (sizes.empty())
+            return -1;
+        auto backend = fastest(0);
+        for (auto& crossover: crossovers) {
+            if (boid_num >= crossover.boid_num)
+                backend = crossover.to;
+        }
+        return backend;
+    }
+} // namespace Group_Animation
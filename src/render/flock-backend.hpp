@@ -0,0 +1,119 @@
+#pragma once
+
+#include "worker-pool.hpp"
+
+#include <vector>
+
+namespace Group_Animation
+{
+    struct Flock;
+
+    enum struct Flock_Kernel
+    {
+        scalar,
+        // structure of arrays, squared distances, 8 lanes per iteration (AVX2 when built with ENABLE_AVX2)
+        simd,
+    };
+
+    // One way of advancing a Flock by a step. The flock owns the boids and every search structure,
+    // a backend only decides where and how the step runs, with its own kernel and threads; the flock's
+    // kernel and worker_pool settings are left alone. Flock::advance handles cpu/gpu residency.
+    struct Flock_Backend
+    {
+        virtual ~Flock_Backend() = default;
+
+        virtual auto name() const -> const char* = 0;
+
+        // the step reads and writes the flock's gpu buffers instead of Flock::boids
+        virtual auto on_gpu() const -> bool
+        {
+            return false;
+        }
+
+        virtual auto step(Flock& flock, float delta_time) -> void = 0;
+    };
+
+    // scalar kernel on the calling thread only
+    struct Scalar_Cpu_Backend final : Flock_Backend
+    {
+        Flock_Kernel kernel{Flock_Kernel::scalar};
+        Parallel::Worker_Pool single_thread{1};
+
+        auto name() const -> const char* override
+        {
+            return "scalar cpu";
+        }
+
+        auto step(Flock& flock, float delta_time) -> void override;
+    };
+
+    // scalar kernel on the shared worker pool
+    struct Threaded_Cpu_Backend final : Flock_Backend
+    {
+        Flock_Kernel kernel{Flock_Kernel::scalar};
+        // null uses Parallel::Worker_Pool::shared()
+        Parallel::Worker_Pool* worker_pool{nullptr};
+        auto name() const -> const char* override
+        {
+            return "threaded cpu";
+        }
+
+        auto step(Flock& flock, float delta_time) -> void override;
+    };
+
+    // soa kernel on the shared worker pool
+    struct Simd_Cpu_Backend final : Flock_Backend
+    {
+        Flock_Kernel kernel{Flock_Kernel::simd};
+        // null uses Parallel::Worker_Pool::shared()
+        Parallel::Worker_Pool* worker_pool{nullptr};
+        auto name() const -> const char* override
+        {
+            return "simd cpu";
+        }
+
+        auto step(Flock& flock, float delta_time) -> void override;
+    };
+
+    struct Gpu_Backend final : Flock_Backend
+    {
+        auto name() const -> const char* override
+        {
+            return "gpu compute";
+        }
+
+        auto on_gpu() const -> bool override
+        {
+            return true;
+        }
+
+        auto step(Flock& flock, float delta_time) -> void override;
+    };
+
+    // flocks of boid_num and more run faster on backend `to` than on `from`
+    struct Backend_Crossover final
+    {
+        int boid_num{};
+        int from{};
+        int to{};
+    };
+
+    struct Backend_Calibration final
+    {
+        std::vector<int> sizes{};
+
+        // steps_per_second[backend][size index], 0 where a backend was already too slow at a smaller size
+        std::vector<std::vector<float>> steps_per_second{};
+
+        // ascending boid_num
+        std::vector<Backend_Crossover> crossovers{};
+
+        auto fastest(int size_index) const -> int;
+
+        // where adjacent sizes disagree on the fastest backend, the crossing of the two rates in log-log space
+        auto find_crossovers() -> void;
+
+        // -1 before calibration
+        auto choose(int boid_num) const -> int;
+    };
+} // namespace Group_Animation
@@ -0,0 +1,232 @@
+#include "group-animation.hpp"
+
+#include <bit>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Group_Animation
+{
+#if defined(__AVX2__)
+    static auto sum_lanes(__m256 v) -> float
+    {
+        auto half = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_movehdup_ps(half));
+        return _mm_cvtss_f32(half);
+    }
+
+    static auto mul_add(__m256 a, __m256 b, __m256 c) -> __m256
+    {
+#if defined(__FMA__)
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+
+    // Compares squared distances so there is no sqrt per pair, 8 neighbors per iteration.
+    // The last block of a row is masked, masked loads never touch memory past the row.
+    auto Boid_Grid::accumulate_soa(const glm::vec3& p, float min_distance, float visual_range) const -> Steering_Sum
+    {
+        auto qx = _mm256_set1_ps(p.x);
+        auto qy = _mm256_set1_ps(p.y);
+        auto qz = _mm256_set1_ps(p.z);
+        auto min2 = _mm256_set1_ps(min_distance * min_distance);
+        auto range2 = _mm256_set1_ps(visual_range * visual_range);
+        auto one = _mm256_set1_ps(1.0f);
+        auto lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        auto move_x = _mm256_setzero_ps(), move_y = _mm256_setzero_ps(), move_z = _mm256_setzero_ps();
+        auto center_x = _mm256_setzero_ps(), center_y = _mm256_setzero_ps(), center_z = _mm256_setzero_ps();
+        auto align_x = _mm256_setzero_ps(), align_y = _mm256_setzero_ps(), align_z = _mm256_setzero_ps();
+        auto count = _mm256_setzero_ps();
+
+        for_each_neighbor_range(p, [&](int begin, int end) -> void {
+            for (auto i = begin; i < end; i += 8) {
+                auto mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(end - i), lane);
+                auto ox = _mm256_maskload_ps(px.data() + i, mask);
+                auto oy = _mm256_maskload_ps(py.data() + i, mask);
+                auto oz = _mm256_maskload_ps(pz.data() + i, mask);
+
+                auto dx = _mm256_sub_ps(qx, ox);
+                auto dy = _mm256_sub_ps(qy, oy);
+                auto dz = _mm256_sub_ps(qz, oz);
+                auto d2 = mul_add(dx, dx, mul_add(dy, dy, _mm256_mul_ps(dz, dz)));
+
+                auto valid = _mm256_castsi256_ps(mask);
+                auto near = _mm256_and_ps(_mm256_cmp_ps(d2, min2, _CMP_LT_OQ), valid);
+                auto seen = _mm256_and_ps(_mm256_cmp_ps(d2, range2, _CMP_LT_OQ), valid);
+
+                move_x = _mm256_add_ps(move_x, _mm256_and_ps(near, dx));
+                move_y = _mm256_add_ps(move_y, _mm256_and_ps(near, dy));
+                move_z = _mm256_add_ps(move_z, _mm256_and_ps(near, dz));
+
+                center_x = _mm256_add_ps(center_x, _mm256_and_ps(seen, ox));
+                center_y = _mm256_add_ps(center_y, _mm256_and_ps(seen, oy));
+                center_z = _mm256_add_ps(center_z, _mm256_and_ps(seen, oz));
+
+                align_x = _mm256_add_ps(align_x, _mm256_and_ps(seen, _mm256_maskload_ps(vx.data() + i, mask)));
+                align_y = _mm256_add_ps(align_y, _mm256_and_ps(seen, _mm256_maskload_ps(vy.data() + i, mask)));
+                align_z = _mm256_add_ps(align_z, _mm256_and_ps(seen, _mm256_maskload_ps(vz.data() + i, mask)));
+
+                count = _mm256_add_ps(count, _mm256_and_ps(seen, one));
+            }
+        });
+
+        auto sum = Steering_Sum{};
+        sum.move = {sum_lanes(move_x), sum_lanes(move_y), sum_lanes(move_z), 0.0f};
+        sum.center = {sum_lanes(center_x), sum_lanes(center_y), sum_lanes(center_z), 0.0f};
+        sum.align = {sum_lanes(align_x), sum_lanes(align_y), sum_lanes(align_z), 0.0f};
+        sum.neighbor_num = int(sum_lanes(count));
+        return sum;
+    }
+
+    auto Boid_Grid::collect_soa(const glm::vec3& p, float range, std::vector<int>& out) const -> void
+    {
+        auto qx = _mm256_set1_ps(p.x);
+        auto qy = _mm256_set1_ps(p.y);
+        auto qz = _mm256_set1_ps(p.z);
+        auto range2 = _mm256_set1_ps(range * range);
+        auto lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        for_each_neighbor_range(p, [&](int begin, int end) -> void {
+            for (auto i = begin; i < end; i += 8) {
+                auto mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(end - i), lane);
+                auto dx = _mm256_sub_ps(qx, _mm256_maskload_ps(px.data() + i, mask));
+                auto dy = _mm256_sub_ps(qy, _mm256_maskload_ps(py.data() + i, mask));
+                auto dz = _mm256_sub_ps(qz, _mm256_maskload_ps(pz.data() + i, mask));
+                auto d2 = mul_add(dx, dx, mul_add(dy, dy, _mm256_mul_ps(dz, dz)));
+                auto inside = _mm256_and_ps(_mm256_cmp_ps(d2, range2, _CMP_LT_OQ), _mm256_castsi256_ps(mask));
+                for (auto bits = unsigned(_mm256_movemask_ps(inside)); bits != 0; bits &= bits - 1) {
+                    out.emplace_back(i + std::countr_zero(bits));
+                }
+            }
+        });
+    }
+
+    // Same sums as accumulate_soa on the grid, but list entries are scattered, so every lane is a gather.
+    auto Neighbor_Lists::accumulate_soa(int i, float min_distance, float visual_range) const -> Steering_Sum
+    {
+        auto a = slot_of[i];
+        auto qx = _mm256_set1_ps(px[a]);
+        auto qy = _mm256_set1_ps(py[a]);
+        auto qz = _mm256_set1_ps(pz[a]);
+        auto min2 = _mm256_set1_ps(min_distance * min_distance);
+        auto range2 = _mm256_set1_ps(visual_range * visual_range);
+        auto one = _mm256_set1_ps(1.0f);
+        auto zero = _mm256_setzero_ps();
+        auto lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+        auto move_x = zero, move_y = zero, move_z = zero;
+        auto center_x = zero, center_y = zero, center_z = zero;
+        auto align_x = zero, align_y = zero, align_z = zero;
+        auto count = zero;
+
+        auto end = list_start[a + 1];
+        for (auto k = list_start[a]; k < end; k += 8) {
+            auto mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(end - k), lane);
+            auto valid = _mm256_castsi256_ps(mask);
+            auto index = _mm256_maskload_epi32(slots.data() + k, mask);
+            auto ox = _mm256_mask_i32gather_ps(zero, px.data(), index, valid, 4);
+            auto oy = _mm256_mask_i32gather_ps(zero, py.data(), index, valid, 4);
+            auto oz = _mm256_mask_i32gather_ps(zero, pz.data(), index, valid, 4);
+
+            auto dx = _mm256_sub_ps(qx, ox);
+            auto dy = _mm256_sub_ps(qy, oy);
+            auto dz = _mm256_sub_ps(qz, oz);
+            auto d2 = mul_add(dx, dx, mul_add(dy, dy, _mm256_mul_ps(dz, dz)));
+
+            auto near = _mm256_and_ps(_mm256_cmp_ps(d2, min2, _CMP_LT_OQ), valid);
+            auto seen = _mm256_and_ps(_mm256_cmp_ps(d2, range2, _CMP_LT_OQ), valid);
+
+            move_x = _mm256_add_ps(move_x, _mm256_and_ps(near, dx));
+            move_y = _mm256_add_ps(move_y, _mm256_and_ps(near, dy));
+            move_z = _mm256_add_ps(move_z, _mm256_and_ps(near, dz));
+
+            center_x = _mm256_add_ps(center_x, _mm256_and_ps(seen, ox));
+            center_y = _mm256_add_ps(center_y, _mm256_and_ps(seen, oy));
+            center_z = _mm256_add_ps(center_z, _mm256_and_ps(seen, oz));
+
+            // velocities only for lanes in range, the others stay zero
+            align_x = _mm256_add_ps(align_x, _mm256_mask_i32gather_ps(zero, vx.data(), index, seen, 4));
+            align_y = _mm256_add_ps(align_y, _mm256_mask_i32gather_ps(zero, vy.data(), index, seen, 4));
+            align_z = _mm256_add_ps(align_z, _mm256_mask_i32gather_ps(zero, vz.data(), index, seen, 4));
+
+            count = _mm256_add_ps(count, _mm256_and_ps(seen, one));
+        }
+
+        auto sum = Steering_Sum{};
+        sum.move = {sum_lanes(move_x), sum_lanes(move_y), sum_lanes(move_z), 0.0f};
+        sum.center = {sum_lanes(center_x), sum_lanes(center_y), sum_lanes(center_z), 0.0f};
+        sum.align = {sum_lanes(align_x), sum_lanes(align_y), sum_lanes(align_z), 0.0f};
+        sum.neighbor_num = int(sum_lanes(count));
+        return sum;
+    }
+#else
+    // Same math as the AVX2 kernel with plain loops over the component arrays, left to the compiler to vectorize.
+    auto Boid_Grid::accumulate_soa(const glm::vec3& p, float min_distance, float visual_range) const -> Steering_Sum
+    {
+        auto min2 = min_distance * min_distance;
+        auto range2 = visual_range * visual_range;
+
+        auto sum = Steering_Sum{};
+        for_each_neighbor_range(p, [&](int begin, int end) -> void {
+            for (auto i = begin; i < end; i++) {
+                auto dx = p.x - px[i];
+                auto dy = p.y - py[i];
+                auto dz = p.z - pz[i];
+                auto d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 < min2) {
+                    sum.move += glm::vec4{dx, dy, dz, 0.0f};
+                }
+                if (d2 < range2) {
+                    sum.center += glm::vec4{px[i], py[i], pz[i], 0.0f};
+                    sum.align += glm::vec4{vx[i], vy[i], vz[i], 0.0f};
+                    sum.neighbor_num++;
+                }
+            }
+        });
+        return sum;
+    }
+    auto Boid_Grid::collect_soa(const glm::vec3& p, float range, std::vector<int>& out) const -> void
+    {
+        auto range2 = range * range;
+        for_each_neighbor_range(p, [&](int begin, int end) -> void {
+            for (auto i = begin; i < end; i++) {
+                auto dx = p.x - px[i];
+                auto dy = p.y - py[i];
+                auto dz = p.z - pz[i];
+                if (dx * dx + dy * dy + dz * dz < range2)
+                    out.emplace_back(i);
+            }
+        });
+    }
+
+    auto Neighbor_Lists::accumulate_soa(int i, float min_distance, float visual_range) const -> Steering_Sum
+    {
+        auto a = slot_of[i];
+        auto min2 = min_distance * min_distance;
+        auto range2 = visual_range * visual_range;
+
+        auto sum = Steering_Sum{};
+        for (auto k = list_start[a]; k < list_start[a + 1]; k++) {
+            auto b = slots[k];
+            auto dx = px[a] - px[b];
+            auto dy = py[a] - py[b];
+            auto dz = pz[a] - pz[b];
+            auto d2 = dx * dx + dy * dy + dz * dz;
+            if (d2 < min2) {
+                sum.move += glm::vec4{dx, dy, dz, 0.0f};
+            }
+            if (d2 < range2) {
+                sum.center += glm::vec4{px[b], py[b], pz[b], 0.0f};
+                sum.align += glm::vec4{vx[b], vy[b], vz[b], 0.0f};
+                sum.neighbor_num++;
+            }
+        }
+        return sum;
+    }
+#endif
+} // namespace Group_Animation
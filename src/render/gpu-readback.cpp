@@ -0,0 +1,71 @@
+#include "gpu-readback.hpp"
+
+namespace render
+{
+    auto Readback_Ring::init(int slot_num, GLsizeiptr slot_capacity) -> void
+    {
+        release();
+
+        capacity = slot_capacity;
+        slots.resize(slot_num);
+        for (auto& slot: slots) {
+            auto flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glCreateBuffers(1, &slot.buffer);
+            glNamedBufferStorage(slot.buffer, capacity, nullptr, flags);
+            slot.mapped = glMapNamedBufferRange(slot.buffer, 0, capacity, flags);
+        }
+    }
+
+    auto Readback_Ring::release() -> void
+    {
+        for (auto& slot: slots) {
+            if (slot.fence != nullptr)
+                glDeleteSync(slot.fence);
+            // deleting a persistently mapped buffer unmaps it
+            glDeleteBuffers(1, &slot.buffer);
+        }
+        slots.clear();
+        capacity = 0;
+        latest_slot = -1;
+    }
+
+    auto Readback_Ring::request(GLuint src_buffer, GLintptr offset, GLsizeiptr size, std::uint64_t frame) -> bool
+    {
+        if (size > capacity) {
+            // growing drops the old snapshots, the buffers are reallocated with room to spare
+            init(slots.empty() ? 3 : slots.size(), size * 2);
+        }
+
+        for (auto i = 0; i < slots.size(); i++) {
+            auto& slot = slots[i];
+            // the latest completed slot stays readable until a newer one replaces it
+            if (slot.fence != nullptr || i == latest_slot)
+                continue;
+
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            glCopyNamedBufferSubData(src_buffer, slot.buffer, offset, 0, size);
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            slot.size = size;
+            slot.frame = frame;
+            return true;
+        }
+        return false;
+    }
+
+    auto Readback_Ring::poll() -> void
+    {
+        for (auto i = 0; i < slots.size(); i++) {
+            auto& slot = slots[i];
+            if (slot.fence == nullptr)
+                continue;
+
+            auto status = glClientWaitSync(slot.fence, 0, 0);
+            if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+                glDeleteSync(slot.fence);
+                slot.fence = nullptr;
+                if (latest_slot < 0 || slot.frame > slots[latest_slot].frame)
+                    latest_slot = i;
+            }
+        }
+    }
+} // namespace render
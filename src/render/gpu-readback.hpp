@@ -0,0 +1,44 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+#include <cstdint>
+
+namespace render
+{
+    // Copies a gpu buffer range into persistently mapped staging slots, each slot guarded by a fence.
+    // Nothing here ever waits on the gpu: a request is dropped when every slot is still in flight,
+    // and latest() only hands out slots whose fence has already signaled.
+    struct Readback_Ring final
+    {
+        struct Slot final
+        {
+            GLuint buffer{};
+            void* mapped{nullptr};
+            GLsync fence{nullptr};
+            GLsizeiptr size{};
+            std::uint64_t frame{};
+        };
+
+        std::vector<Slot> slots{};
+
+        GLsizeiptr capacity{};
+
+        int latest_slot{-1};
+
+        auto init(int slot_num, GLsizeiptr slot_capacity) -> void;
+
+        auto release() -> void;
+
+        // queue a copy of [offset, offset + size) of src_buffer tagged with frame, false if no slot is free
+        auto request(GLuint src_buffer, GLintptr offset, GLsizeiptr size, std::uint64_t frame) -> bool;
+
+        // retire every slot whose fence has signaled
+        auto poll() -> void;
+
+        auto latest() const -> const Slot*
+        {
+            return latest_slot >= 0 ? &slots[latest_slot] : nullptr;
+        }
+    };
+} // namespace render
@@ -0,0 +1,56 @@
+#include "gpu-timer.hpp"
+
+namespace render
+{
+    auto Gpu_Timer::init() -> void
+    {
+        release();
+        glGenQueries(query_num, queries);
+    }
+
+    auto Gpu_Timer::release() -> void
+    {
+        if (queries[0] != 0)
+            glDeleteQueries(query_num, queries);
+        for (auto& query: queries)
+            query = 0;
+        head = 0;
+        pending = 0;
+        elapsed_ms = -1.0f;
+        average_ms = -1.0f;
+    }
+
+    auto Gpu_Timer::begin() -> bool
+    {
+        collect(false);
+        if (queries[0] == 0 || pending == query_num)
+            return false;
+        glBeginQuery(GL_TIME_ELAPSED, queries[(head + pending) % query_num]);
+        return true;
+    }
+
+    auto Gpu_Timer::end() -> void
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        pending++;
+    }
+
+    auto Gpu_Timer::collect(bool wait) -> void
+    {
+        while (pending > 0) {
+            if (!wait) {
+                auto available = GLint{GL_FALSE};
+                glGetQueryObjectiv(queries[head], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available == GL_FALSE)
+                    return;
+            }
+            // GL_QUERY_RESULT blocks until the query is available
+            auto ns = GLuint64{};
+            glGetQueryObjectui64v(queries[head], GL_QUERY_RESULT, &ns);
+            elapsed_ms = float(ns) * 1e-6f;
+            average_ms = average_ms < 0.0f ? elapsed_ms : 0.9f * average_ms + 0.1f * elapsed_ms;
+            head = (head + 1) % query_num;
+            pending--;
+        }
+    }
+} // namespace render
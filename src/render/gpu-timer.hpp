@@ -0,0 +1,35 @@
+#pragma once
+
+#include <GL/glew.h>
+
+namespace render
+{
+    // GL_TIME_ELAPSED queries in a small ring, results are picked up a few frames later without stalling.
+    // Only one timer may be between begin() and end() at a time, GL allows a single active TIME_ELAPSED query.
+    struct Gpu_Timer final
+    {
+        static constexpr int query_num = 4;
+
+        GLuint queries[query_num]{};
+
+        // issued but not yet read back, oldest first starting at head
+        int head{0};
+        int pending{0};
+
+        // last finished measurement and a smoothed value for display, -1 until the first result
+        float elapsed_ms{-1.0f};
+        float average_ms{-1.0f};
+
+        auto init() -> void;
+
+        auto release() -> void;
+
+        // false when every query is still in flight, end() must then be skipped as well
+        auto begin() -> bool;
+
+        auto end() -> void;
+
+        // read every finished query, wait = true blocks on the ones in flight (offline measurements only)
+        auto collect(bool wait) -> void;
+    };
+} // namespace render
@@ -1,46 +1,131 @@
 #include "group-animation.hpp"
+#include <glm/gtc/packing.hpp>
 #include <nlohmann/json.hpp>
 #include <format>
-#include <thread>
 #include <fstream>
+#include <sstream>
+#include <chrono>
+#include <bit>
 
 namespace Group_Animation
 {
-    auto Boid::strategy() -> void
+    static auto random_boid(std::mt19937& rng, float extent) -> Boid
     {
+        auto distribution = std::uniform_real_distribution<float>(-extent, extent);
+        auto x = distribution(rng);
+        auto y = distribution(rng);
+        auto z = distribution(rng);
+        return Boid{glm::vec4{x, y, z, 0.0f}};
+    }
 
+    auto Compact_Boid::encode(const Boid& boid) -> Compact_Boid
+    {
+        auto compact = Compact_Boid{};
+        for (auto k = 0; k < 3; k++)
+            compact.position[k] = boid.position[k];
+        compact.rotation[0] = glm::packHalf2x16({boid.rotation.x, boid.rotation.y});
+        compact.rotation[1] = glm::packHalf2x16({boid.rotation.z, boid.rotation.w});
+        compact.velocity[0] = glm::packHalf2x16({boid.velocity.x, boid.velocity.y});
+        compact.velocity[1] = glm::packHalf2x16({boid.velocity.z, 0.0f});
+        return compact;
     }
 
-    auto Boid::update(Flock& flock, float delta_time) -> void
+    auto Compact_Boid::decode() const -> Boid
     {
-        auto nav_point = glm::vec3{};
+        auto rotation_xy = glm::unpackHalf2x16(rotation[0]);
+        auto rotation_zw = glm::unpackHalf2x16(rotation[1]);
+        auto velocity_xy = glm::unpackHalf2x16(velocity[0]);
+        auto velocity_z = glm::unpackHalf2x16(velocity[1]);
 
-        glm::vec4 old_vec = velocity;
-        glm::vec4 move{};
-        glm::vec4 center{};
-        glm::vec4 align_vec{};
-        auto neighbor_num{0};
+        auto boid = Boid{};
+        boid.position = {position[0], position[1], position[2], 0.0f};
+        boid.rotation = glm::normalize(glm::quat{rotation_zw.y, rotation_xy.x, rotation_xy.y, rotation_zw.x});
+        boid.velocity = {velocity_xy.x, velocity_xy.y, velocity_z.x, 0.0f};
+        return boid;
+    }
 
-        for (auto& boid: flock.boids) {
-            auto dis = glm::distance(position, boid.position);
-            if (dis < flock.min_distance) {
-                move += position - boid.position;
+    auto checksum(const Flock_Snapshot& snapshot) -> Flock_Checksum
+    {
+        auto result = Flock_Checksum{};
+        result.step = snapshot.step;
+        // FNV-1a over the bits the simulation defines, std430 padding is left out
+        auto hash = std::uint64_t{14695981039346656037ull};
+        auto mix = [&](float value) -> void {
+            auto bits = std::bit_cast<std::uint32_t>(value);
+            for (auto k = 0; k < 4; k++) {
+                hash ^= (bits >> (8 * k)) & 0xffu;
+                hash *= 1099511628211ull;
             }
-            if (dis < flock.visual_range) {
-                center += boid.position;
-                align_vec += boid.velocity;
-                neighbor_num++;
+        };
+        for (auto i = 0; i < snapshot.boid_num; i++) {
+            auto& boid = snapshot.boids[i];
+            for (auto k = 0; k < 3; k++)
+                mix(boid.position[k]);
+            for (auto k = 0; k < 4; k++)
+                mix(boid.rotation[k]);
+            for (auto k = 0; k < 3; k++)
+                mix(boid.velocity[k]);
+            result.position_sum += glm::dvec3(boid.position);
+            result.velocity_sum += glm::dvec3(boid.velocity);
+        }
+        result.hash = hash;
+        return result;
+    }
+
+    auto max_position_error(const Flock_Snapshot& a, const Flock_Snapshot& b) -> float
+    {
+        if (a.boid_num != b.boid_num)
+            return INFINITY;
+        auto max_error{0.0f};
+        for (auto i = 0; i < a.boid_num; i++) {
+            max_error = glm::max(max_error, glm::distance(glm::vec3(a.boids[i].position), glm::vec3(b.boids[i].position)));
+        }
+        return max_error;
+    }
+
+    auto Boid::strategy() -> void
+    {
+
+    }
+
+    auto Boid::update(const Flock& flock, float delta_time) const -> Boid
+    {
+        auto sum = Steering_Sum{};
+
+        auto visit = [&](const glm::vec4& other_position, const glm::vec4& other_velocity) -> void {
+            sum.add(position, other_position, other_velocity, flock.min_distance, flock.visual_range);
+        };
+
+        if (flock.use_grid) {
+            flock.grid.for_each_neighbor(position, visit);
+        } else {
+            for (auto& boid: flock.boids) {
+                visit(boid.position, boid.velocity);
             }
         }
 
-        if (neighbor_num > 0) {
-            center /= float(neighbor_num);
-            align_vec /= float(neighbor_num);
+        return integrate(flock, sum, delta_time);
+    }
+
+    auto Boid::integrate(const Flock& flock, const Steering_Sum& sum, float delta_time) const -> Boid
+    {
+        auto nav_point = glm::vec3{};
+
+        auto next = *this;
+        auto& velocity = next.velocity;
+
+        glm::vec4 old_vec = this->velocity;
+        auto center = sum.center;
+        auto align_vec = sum.align;
+
+        if (sum.neighbor_num > 0) {
+            center /= float(sum.neighbor_num);
+            align_vec /= float(sum.neighbor_num);
             velocity += (center - position) * flock.center_factor;
             velocity += (align_vec - velocity) * flock.align_factor;
         }
 
-        velocity += move * flock.avoid_factor;
+        velocity += sum.move * flock.avoid_factor;
 
         velocity = glm::normalize(velocity);
 
@@ -58,28 +143,334 @@ namespace Group_Animation
 
         velocity = glm::normalize(velocity);
 
-        rotation = glm::rotation(glm::normalize(glm::vec3(old_vec)), glm::normalize(glm::vec3(velocity))) * rotation;
-        position += velocity * delta_time;
+        next.rotation = glm::rotation(glm::normalize(glm::vec3(old_vec)), glm::normalize(glm::vec3(velocity))) * rotation;
+        next.position = position + velocity * delta_time;
+        return next;
+    }
+
+    auto Boid_Grid::build(const Boid_Array& boids, float range) -> void
+    {
+        auto lo = glm::vec3(INFINITY);
+        auto hi = glm::vec3(-INFINITY);
+        for (auto& boid: boids) {
+            lo = glm::min(lo, glm::vec3(boid.position));
+            hi = glm::max(hi, glm::vec3(boid.position));
+        }
+        if (boids.empty()) {
+            lo = hi = glm::vec3(0.0f);
+        }
+
+        // cells never smaller than the search range, so the 27 adjacent cells cover it;
+        // sparse outliers only make cells coarser instead of blowing up the cell count
+        constexpr auto max_cell_num = 1 << 21;
+        origin = lo;
+        cell_size = glm::max(range, 1e-4f);
+        auto extent = hi - lo;
+        dims = glm::ivec3(extent / cell_size) + 1;
+        while (size_t(dims.x) * dims.y * dims.z > max_cell_num) {
+            cell_size *= 1.25f;
+            dims = glm::ivec3(extent / cell_size) + 1;
+        }
+
+        auto cell_num = dims.x * dims.y * dims.z;
+        cell_start.assign(cell_num + 1, 0);
+        boid_cell.resize(boids.size());
+        sorted_position.resize(boids.size());
+        sorted_velocity.resize(boids.size());
+        sorted_id.resize(boids.size());
+
+        // counting sort: histogram, exclusive prefix sum, then scatter
+        for (auto i = 0; i < boids.size(); i++) {
+            boid_cell[i] = cell_index(cell_coord(boids[i].position));
+            cell_start[boid_cell[i] + 1]++;
+        }
+        for (auto c = 0; c < cell_num; c++) {
+            cell_start[c + 1] += cell_start[c];
+        }
+        auto cursor = std::vector<int>(cell_start.begin(), cell_start.end() - 1);
+        for (auto i = 0; i < boids.size(); i++) {
+            auto slot = cursor[boid_cell[i]]++;
+            sorted_position[slot] = boids[i].position;
+            sorted_velocity[slot] = boids[i].velocity;
+            sorted_id[slot] = i;
+        }
+
+        if (build_soa) {
+            for (auto array: {&px, &py, &pz, &vx, &vy, &vz}) {
+                array->resize(boids.size());
+            }
+            for (auto i = 0; i < boids.size(); i++) {
+                px[i] = sorted_position[i].x;
+                py[i] = sorted_position[i].y;
+                pz[i] = sorted_position[i].z;
+                vx[i] = sorted_velocity[i].x;
+                vy[i] = sorted_velocity[i].y;
+                vz[i] = sorted_velocity[i].z;
+            }
+        }
     }
 
-    auto Boid::get_affine_matrix() -> glm::mat4x4
+    auto Neighbor_Lists::needs_rebuild(const Boid_Array& boids, float range, float skin, int rebuild_interval) const -> bool
     {
-        return glm::translate(glm::mat4x4(1.0f), glm::vec3(position)) * glm::toMat4(rotation);
+        if (reference_position.size() != boids.size() || age >= rebuild_interval)
+            return true;
+        if (range != built_range || skin != built_skin)
+            return true;
+        // a pair closes in by at most the sum of both displacements
+        auto limit = 0.25f * skin * skin;
+        for (auto i = 0; i < boids.size(); i++) {
+            auto offset = glm::vec3(boids[i].position - reference_position[i]);
+            if (glm::dot(offset, offset) > limit)
+                return true;
+        }
+        return false;
     }
 
-    auto Flock::init(const std::string boid_config_path, const std::string flock_config_path) -> void
+    auto Neighbor_Lists::build(const Boid_Array& boids, Boid_Grid& grid, float range, float skin, Parallel::Worker_Pool& pool) -> void
     {
-        boid_model.load_with_config(boid_config_path);
+        auto list_range = range + skin;
+        built_range = range;
+        built_skin = skin;
+        grid.build_soa = true;
+        grid.build(boids, list_range);
+
+        // one search pass into per block lists, then concatenated in block order, so the result
+        // does not depend on which worker ran which block
+        constexpr auto block_size = 256;
+        auto boid_num = int(boids.size());
+        auto block_num = (boid_num + block_size - 1) / block_size;
+        block_slots.resize(block_num);
+        list_start.resize(boid_num + 1);
+        pool.parallel_for(block_num, 1, [&](int block_begin, int block_end) -> void {
+            for (auto block = block_begin; block < block_end; block++) {
+                auto& out = block_slots[block];
+                out.clear();
+                for (auto a = block * block_size; a < glm::min(boid_num, (block + 1) * block_size); a++) {
+                    grid.collect_soa(grid.sorted_position[a], list_range, out);
+                    // local end for now, offset by the block start below
+                    list_start[a + 1] = out.size();
+                }
+            }
+        });
+
+        auto block_start = std::vector<int>(block_num + 1, 0);
+        for (auto block = 0; block < block_num; block++) {
+            block_start[block + 1] = block_start[block] + block_slots[block].size();
+        }
+        slots.resize(block_start.back());
+        list_start[0] = 0;
+        pool.parallel_for(block_num, 1, [&](int block_begin, int block_end) -> void {
+            for (auto block = block_begin; block < block_end; block++) {
+                std::copy(block_slots[block].begin(), block_slots[block].end(), slots.begin() + block_start[block]);
+                for (auto a = block * block_size; a < glm::min(boid_num, (block + 1) * block_size); a++) {
+                    list_start[a + 1] += block_start[block];
+                }
+            }
+        });
+
+        order = grid.sorted_id;
+        slot_of.resize(boid_num);
+        reference_position.resize(boid_num);
+        for (auto a = 0; a < boid_num; a++) {
+            slot_of[order[a]] = a;
+        }
         for (auto i = 0; i < boid_num; i++) {
-            boids.emplace_back(glm::vec4{float(rand())/float(RAND_MAX) - 0.5f , float(rand())/float(RAND_MAX) - 0.5f , float(rand())/float(RAND_MAX) - 0.5f, 0.0f});
+            reference_position[i] = boids[i].position;
+        }
+        age = 0;
+        rebuild_num++;
+    }
+
+    auto Neighbor_Lists::gather(const Boid_Array& boids) -> void
+    {
+        for (auto array: {&px, &py, &pz, &vx, &vy, &vz}) {
+            array->resize(boids.size());
+        }
+        for (auto a = 0; a < boids.size(); a++) {
+            auto& boid = boids[order[a]];
+            px[a] = boid.position.x;
+            py[a] = boid.position.y;
+            pz[a] = boid.position.z;
+            vx[a] = boid.velocity.x;
+            vy[a] = boid.velocity.y;
+            vz[a] = boid.velocity.z;
+        }
+    }
+
+    auto Gpu_Boid_Grid::init(const std::string& layout) -> void
+    {
+        // keeps program_id, so compile deletes the old program once the new one links
+        shader.shader_stage_type_to_path = {{GL_COMPUTE_SHADER, "asset/shaders/Boid_Grid.comp"}};
+        shader.compile(layout);
+        uniforms = {
+            shader.uniform<int>("boid_num"),
+            shader.uniform<int>("cell_num"),
+            shader.uniform<glm::vec3>("grid_origin"),
+            shader.uniform<float>("cell_size"),
+            shader.uniform<glm::ivec3>("grid_dims"),
+            shader.uniform<int>("grid_pass"),
+        };
+
+        if (sorted_boid_buffer != 0)
+            return;
+        glCreateBuffers(1, &sorted_boid_buffer);
+        glCreateBuffers(1, &sorted_id_buffer);
+        glCreateBuffers(1, &cell_start_buffer);
+        glCreateBuffers(1, &boid_cell_buffer);
+        glCreateBuffers(1, &block_sum_buffer);
+    }
+
+    auto Gpu_Boid_Grid::release() -> void
+    {
+        for (auto buffer: {&sorted_boid_buffer, &sorted_id_buffer, &cell_start_buffer, &boid_cell_buffer, &block_sum_buffer}) {
+            glDeleteBuffers(1, buffer);
+            *buffer = 0;
+        }
+        boid_capacity = 0;
+        cell_capacity = 0;
+        shader.release();
+    }
+
+    auto Gpu_Boid_Grid::reserve(int boid_num, int cell_num) -> void
+    {
+        // everything here is rebuilt every step, so growing never has to keep the old contents
+        if (boid_num > boid_capacity) {
+            boid_capacity = glm::max(boid_num, 2 * boid_capacity);
+            glNamedBufferData(sorted_boid_buffer, boid_stride * boid_capacity, nullptr, GL_DYNAMIC_COPY);
+            glNamedBufferData(sorted_id_buffer, sizeof(int) * boid_capacity, nullptr, GL_DYNAMIC_COPY);
+            glNamedBufferData(boid_cell_buffer, sizeof(glm::ivec2) * boid_capacity, nullptr, GL_DYNAMIC_COPY);
         }
-        compute_shader = render::Shader{{{GL_COMPUTE_SHADER, "asset/shaders/Boid.comp"}}};
-        compute_shader.compile();
+        if (cell_num > cell_capacity) {
+            cell_capacity = glm::max(cell_num, 2 * cell_capacity);
+            glNamedBufferData(cell_start_buffer, sizeof(int) * (cell_capacity + 1), nullptr, GL_DYNAMIC_COPY);
+            glNamedBufferData(block_sum_buffer, sizeof(int) * (cell_capacity / group_size + 1), nullptr, GL_DYNAMIC_COPY);
+        }
+    }
+
+    auto Gpu_Boid_Grid::build(unsigned int boids_in, int boid_num, float range) -> void
+    {
+        cell_size = glm::max(range, 2.0f * half_extent / max_dim);
+        dims = glm::max(glm::ivec3(glm::ceil(glm::vec3(2.0f * half_extent / cell_size))), glm::ivec3(1));
+        origin = glm::vec3(-half_extent);
+
+        reserve(boid_num, cell_num());
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boids_in);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sorted_boid_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, sorted_id_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, cell_start_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, boid_cell_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, block_sum_buffer);
+
+        shader.apply();
+        shader.set(uniforms.boid_num, boid_num);
+        shader.set(uniforms.cell_num, cell_num());
+        shader.set(uniforms.grid_origin, origin);
+        shader.set(uniforms.cell_size, cell_size);
+        shader.set(uniforms.grid_dims, dims);
+
+        auto boid_groups = (boid_num + group_size - 1) / group_size;
+        auto cell_groups = (cell_num() + group_size) / group_size;
+        auto run_pass = [&](int pass, int groups) -> void {
+            shader.set(uniforms.grid_pass, pass);
+            glDispatchCompute(groups, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        };
+        // clear, bin, scan blocks, scan block sums, add block sums, scatter, sort cells by id (see Boid_Grid.comp)
+        run_pass(0, cell_groups);
+        run_pass(1, boid_groups);
+        run_pass(2, cell_groups);
+        run_pass(3, 1);
+        run_pass(4, cell_groups);
+        run_pass(5, boid_groups);
+        run_pass(6, cell_groups);
+    }
+
+    auto Gpu_Boid_Culler::init(const std::string& layout) -> void
+    {
+        shader.shader_stage_type_to_path = {{GL_COMPUTE_SHADER, "asset/shaders/Boid_Cull.comp"}};
+        shader.compile(layout);
+        uniforms = {
+            shader.uniform<int>("boid_num"),
+            shader.uniform<float>("radius"),
+            shader.uniform<glm::vec4>("planes"),
+        };
+
+        if (command_buffer != 0)
+            return;
+        glCreateBuffers(1, &visible_buffer);
+        glCreateBuffers(1, &command_buffer);
+        glNamedBufferData(command_buffer, sizeof(Draw_Elements_Command), nullptr, GL_DYNAMIC_DRAW);
+        count_readback.init(3, sizeof(Draw_Elements_Command));
+    }
+
+    auto Gpu_Boid_Culler::release() -> void
+    {
+        glDeleteBuffers(1, &visible_buffer);
+        glDeleteBuffers(1, &command_buffer);
+        visible_buffer = command_buffer = 0;
+        boid_capacity = 0;
+        count_readback.release();
+        visible_num = -1;
+        shader.release();
+    }
+
+    auto Gpu_Boid_Culler::reserve(int boid_num) -> void
+    {
+        if (boid_num > boid_capacity) {
+            boid_capacity = glm::max(boid_num, 2 * boid_capacity);
+            glNamedBufferData(visible_buffer, sizeof(int) * boid_capacity, nullptr, GL_DYNAMIC_COPY);
+        }
+    }
+
+    auto Gpu_Boid_Culler::cull(unsigned int boids_in, int boid_num, int index_num, float radius, const glm::mat4& view_proj) -> void
+    {
+        reserve(boid_num);
 
-        glGenBuffers(1, &boid_buffer);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, boid_buffer);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, 10000 * sizeof(Boid), nullptr, GL_DYNAMIC_COPY);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boid_buffer);
+        auto command = Draw_Elements_Command{std::uint32_t(index_num)};
+        glNamedBufferSubData(command_buffer, 0, sizeof(command), &command);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boids_in);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, visible_buffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, command_buffer);
+
+        shader.apply();
+        shader.set(uniforms.boid_num, boid_num);
+        shader.set(uniforms.radius, radius);
+        auto planes = frustum_planes(view_proj);
+        shader.set(uniforms.planes, planes.data(), GLsizei(planes.size()));
+
+        glDispatchCompute((boid_num + group_size - 1) / group_size, 1, 1);
+        // the draw reads the ids and the command, the readback copies the command
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer);
+
+        count_readback.poll();
+        count_readback.request(command_buffer, 0, sizeof(Draw_Elements_Command), ++cull_id);
+        if (auto slot = count_readback.latest(); slot != nullptr)
+            visible_num = int(static_cast<const Draw_Elements_Command*>(slot->mapped)->instance_count);
+    }
+
+    auto Gpu_Boid_Culler::frustum_planes(const glm::mat4& view_proj) -> std::array<glm::vec4, 6>
+    {
+        // rows of viewProj, clip space -w <= x, y, z <= w gives one plane per inequality
+        auto row = [&](int r) -> glm::vec4 {
+            return {view_proj[0][r], view_proj[1][r], view_proj[2][r], view_proj[3][r]};
+        };
+        auto planes = std::array<glm::vec4, 6>{
+            row(3) + row(0), row(3) - row(0),
+            row(3) + row(1), row(3) - row(1),
+            row(3) + row(2), row(3) - row(2),
+        };
+        for (auto& plane: planes)
+            plane /= glm::length(glm::vec3(plane));
+        return planes;
+    }
+
+    auto Flock::init(const std::string boid_config_path, const std::string flock_config_path) -> void
+    {
+        boid_model.load_with_config(boid_config_path);
+        cull_radius = boid_model.bounding_radius() * boid_model.scale;
 
         std::ifstream cfs(ROOT_DIR + flock_config_path);
         auto flock_cfg = nlohmann::json::parse(cfs, nullptr, true, true);
@@ -89,83 +480,609 @@ namespace Group_Animation
         avoid_factor = flock_cfg.find("avoid_factor").value();
         center_factor = flock_cfg.find("center_factor").value();
         align_factor = flock_cfg.find("align_factor").value();
+        seed = flock_cfg.find("seed").value();
+
+        rng.seed(seed);
+        for (auto i = 0; i < boid_num; i++) {
+            boids.emplace_back(random_boid(rng, 0.5f));
+        }
+        compile_shaders();
+        step_timer.init();
+
+        reserve(boids.size());
+        upload(0, boids.size());
 
+        backends.emplace_back(std::make_unique<Scalar_Cpu_Backend>());
+        backends.emplace_back(std::make_unique<Threaded_Cpu_Backend>());
+        backends.emplace_back(std::make_unique<Simd_Cpu_Backend>());
+        backends.emplace_back(std::make_unique<Gpu_Backend>());
+        // calibrating runs every backend at every size for seconds, so it waits for the ui
+        default_backend = int(backends.size()) - 1;
+        backend = default_backend;
     }
 
-    auto Flock::update(float delta_time) -> void
+    auto Flock::release() -> void
+    {
+        glDeleteBuffers(2, boid_buffers);
+        boid_buffers[0] = boid_buffers[1] = 0;
+        boid_capacity = 0;
+        gpu_grid.release();
+        culler.release();
+        readback.release();
+        step_timer.release();
+        compute_program.shader.release();
+        for (auto& [groups_of, variant]: compute_variants) {
+            variant.shader.release();
+        }
+        compute_variants.clear();
+        draw_shader.release();
+    }
+
+    auto Flock::compile_shaders() -> void
+    {
+        // every flock shader gets the same Boid layout, see Boid_Layout.glsl
+        std::ifstream lfs(ROOT_DIR + std::string("asset/shaders/Boid_Layout.glsl"));
+        std::stringstream layout_stream{};
+        layout_stream << (compact_boids ? "#define COMPACT_BOID\n" : "") << lfs.rdbuf() << "\n";
+        auto layout = layout_stream.str();
+
+        compute_program.compile(layout);
+        for (auto& [groups_of, variant]: compute_variants) {
+            variant.shader.release();
+        }
+        compute_variants.clear();
+        steering_layout = layout;
+
+        draw_shader.shader_stage_type_to_path = {{GL_VERTEX_SHADER, "asset/shaders/Boid.vert"}, {GL_FRAGMENT_SHADER, "asset/shaders/Basic.frag"}};
+        draw_shader.compile(layout);
+        draw_uniforms = {
+            draw_shader.uniform<glm::mat4>("viewProj"),
+            draw_shader.uniform<glm::vec3>("cam_pos"),
+            draw_shader.uniform<float>("boid_scale"),
+            draw_shader.uniform<bool>("culled"),
+        };
+
+        gpu_grid.boid_stride = boid_stride();
+        gpu_grid.init(layout);
+        culler.init(layout);
+    }
+
+    auto Flock::set_compact(bool compact) -> void
+    {
+        if (compact == compact_boids)
+            return;
+
+        if (gpu_resident) {
+            download();
+            gpu_resident = false;
+        }
+        compact_boids = compact;
+        compile_shaders();
+
+        // the stride changed, so nothing on the gpu can be reused
+        glDeleteBuffers(2, boid_buffers);
+        boid_buffers[0] = boid_buffers[1] = 0;
+        boid_capacity = 0;
+        gpu_grid.boid_capacity = 0;
+        readback.release();
+        snapshot_boids.clear();
+        step_timer.init();
+
+        reserve(boids.size());
+        upload(0, boids.size());
+        std::cout << std::format("flock gpu encoding {:s}, {:d} bytes per boid\n", compact_boids ? "compact" : "full", boid_stride());
+    }
+
+    auto Flock::upload(int first, int count) -> void
     {
-        static auto gpu_data_dirty{true};
+        if (!compact_boids) {
+            glNamedBufferSubData(current_buffer(), sizeof(Boid) * first, sizeof(Boid) * count, boids.data() + first);
+            return;
+        }
+        compact_staging.resize(count);
+        for (auto i = 0; i < count; i++) {
+            compact_staging[i] = Compact_Boid::encode(boids[first + i]);
+        }
+        glNamedBufferSubData(current_buffer(), sizeof(Compact_Boid) * first, sizeof(Compact_Boid) * count, compact_staging.data());
+    }
+
+    auto Flock::download() -> void
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        if (!compact_boids) {
+            glGetNamedBufferSubData(current_buffer(), 0, sizeof(Boid) * boids.size(), boids.data());
+            return;
+        }
+        compact_staging.resize(boids.size());
+        glGetNamedBufferSubData(current_buffer(), 0, sizeof(Compact_Boid) * boids.size(), compact_staging.data());
+        for (auto i = 0; i < boids.size(); i++) {
+            boids[i] = compact_staging[i].decode();
+        }
+    }
+
+    auto Flock::reserve(int boid_count) -> void
+    {
+        if (boid_count <= boid_capacity && boid_buffers[0] != 0)
+            return;
+
+        // at least double, so a flock grown one boid at a time reallocates O(log n) times
+        auto capacity = glm::max(boid_count, glm::max(2 * boid_capacity, 1024));
+        unsigned int buffers[2]{};
+        glCreateBuffers(2, buffers);
+        for (auto buffer: buffers) {
+            glNamedBufferData(buffer, boid_stride() * capacity, nullptr, GL_DYNAMIC_COPY);
+        }
+        if (boid_buffers[0] != 0) {
+            // only the read buffer holds live state, the other one is overwritten by the next step
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+            // called before boids grows, so boids.size() is still the live gpu count
+            glCopyNamedBufferSubData(current_buffer(), buffers[read_buffer], 0, 0, boid_stride() * boids.size());
+            glDeleteBuffers(2, boid_buffers);
+        }
+        boid_buffers[0] = buffers[0];
+        boid_buffers[1] = buffers[1];
+        boid_capacity = capacity;
+        std::cout << std::format("flock gpu capacity {:d} boids\n", boid_capacity);
+    }
 
+    auto Flock::update(float delta_time) -> void
+    {
+        boid_num = glm::clamp(boid_num, 0, max_boid_num);
         if (boid_num != boids.size()) {
             if (boids.size() >= boid_num) {
                 boids.resize(boid_num);    
             } else {
+                auto old_size = boids.size();
+                reserve(boid_num);
                 while (boids.size() < boid_num)
-                    boids.emplace_back(Boid{glm::vec4{float(rand())/float(RAND_MAX) - 0.5f , float(rand())/float(RAND_MAX) - 0.5f , float(rand())/float(RAND_MAX) - 0.5f, 0.0f}});
+                    boids.emplace_back(random_boid(rng, 0.5f));
+                // only the new tail goes up, the rest of the flock stays on the gpu
+                upload(old_size, boids.size() - old_size);
             }
-            gpu_data_dirty = true;
-        }
-        if (!enable_gpu) {
-            gpu_data_dirty = true;
-            std::vector<std::thread> thds;
-            thds.resize(16);
-            auto idx{0};
-            for (auto& thd: thds) {
-                thd = std::thread([&](int id)-> void { 
-                    for (auto i = id; i < boid_num; i += 16) {
-                        boids[i].update(*this, delta_time); 
-                    }
-                }, idx);
-                idx++;
+        }
+        if (auto_backend) {
+            auto chosen = calibration.choose(boid_num);
+            if (chosen < 0)
+                chosen = default_backend;
+            if (chosen != backend) {
+                std::cout << std::format("flock backend {:s} -> {:s} at {:d} boids\n", backends[backend]->name(), backends[chosen]->name(), boid_num);
+                backend = chosen;
             }
-            for (auto& thd: thds) {
-                if (thd.joinable())
-                    thd.join();
+        }
+
+        advance(*backends[backend], delta_time);
+
+        if (uses_gpu() && enable_readback) {
+            readback.poll();
+            readback.request(current_buffer(), 0, boid_stride() * boids.size(), step_id);
+
+            auto slot = readback.latest();
+            if (compact_boids && slot != nullptr && (snapshot_boids.empty() || slot->frame != snapshot_step)) {
+                auto compact = reinterpret_cast<const Compact_Boid*>(slot->mapped);
+                snapshot_boids.resize(slot->size / sizeof(Compact_Boid));
+                for (auto i = 0; i < snapshot_boids.size(); i++) {
+                    snapshot_boids[i] = compact[i].decode();
+                }
+                snapshot_step = slot->frame;
             }
-        } else {
-            if (gpu_data_dirty) {
-                glBindBuffer(GL_SHADER_STORAGE_BUFFER, boid_buffer);
-                glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Boid) * boids.size(), boids.data());
-                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, boid_buffer);
-                gpu_data_dirty = false;
+        }
+        step_id++;
+    }
+
+    auto Flock::advance(Flock_Backend& b, float delta_time) -> void
+    {
+        if (b.on_gpu()) {
+            b.step(*this, delta_time);
+            gpu_resident = true;
+            return;
+        }
+        if (gpu_resident) {
+            // one blocking read when switching back from gpu, never per frame
+            download();
+            gpu_resident = false;
+        }
+        b.step(*this, delta_time);
+
+        // keep the gpu copy current so the instanced draw can read it
+        upload(0, boids.size());
+    }
+
+    auto Flock::calibrate(const std::vector<int>& sizes, float seconds_per_run) -> void
+    {
+        // below this a backend is out of the running, larger flocks would only be slower
+        constexpr auto min_steps_per_second = 5.0f;
+        constexpr auto max_steps = 30;
+
+        if (gpu_resident) {
+            download();
+            gpu_resident = false;
+        }
+        auto saved_boids = boids;
+        auto saved_time_slice = time_slice;
+        time_slice = false;
+
+        calibration = Backend_Calibration{};
+        calibration.sizes = sizes;
+        calibration.steps_per_second.assign(backends.size(), std::vector<float>(sizes.size(), 0.0f));
+
+        auto calibration_rng = std::mt19937{seed};
+        for (auto k = 0; k < sizes.size(); k++) {
+            auto start_boids = Boid_Array{};
+            for (auto i = 0; i < sizes[k]; i++) {
+                start_boids.emplace_back(random_boid(calibration_rng, 2.0f));
             }
+            reserve(sizes[k]);
 
-            compute_shader.apply();
-            compute_shader.setUniform1i("boid_num", boids.size());
-            
-            compute_shader.apply();
-            compute_shader.setUniform1f("min_distance", min_distance);
-            compute_shader.setUniform1f("visual_range", visual_range);
-            compute_shader.setUniform1f("avoid_factor", avoid_factor);
-            compute_shader.setUniform1f("center_factor", center_factor);
-            compute_shader.setUniform1f("align_factor", align_factor);
-            compute_shader.setUniform1f("delta_time", delta_time);
-            glDispatchCompute(16 , 16, 16);
-            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-            glFinish();
+            for (auto b = 0; b < backends.size(); b++) {
+                auto& rates = calibration.steps_per_second[b];
+                if (k > 0 && rates[k - 1] < min_steps_per_second)
+                    continue;
+
+                auto& candidate = *backends[b];
+                boids = start_boids;
+                upload(0, boids.size());
+                gpu_resident = false;
+
+                // warm up: first dispatches, grid and list allocations, residency for this backend
+                advance(candidate, 1.0f / 60.0f);
+                if (candidate.on_gpu())
+                    glFinish();
+
+                // the step alone: advance would add the full flock upload after every cpu step
+                auto start = std::chrono::high_resolution_clock::now();
+                auto steps{0};
+                auto elapsed{0.0};
+                while (steps < max_steps && elapsed < seconds_per_run) {
+                    candidate.step(*this, 1.0f / 60.0f);
+                    // gpu work is only done once the queue drains
+                    if (candidate.on_gpu())
+                        glFinish();
+                    steps++;
+                    elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                }
+                rates[k] = float(steps / elapsed);
+                std::cout << std::format("flock calibration {:s} {:d} boids: {:.1f} steps/s\n", candidate.name(), sizes[k], rates[k]);
+            }
+        }
+
+        calibration.find_crossovers();
+        for (auto& crossover: calibration.crossovers) {
+            std::cout << std::format("flock crossover {:s} -> {:s} at {:d} boids\n", backends[crossover.from]->name(), backends[crossover.to]->name(), crossover.boid_num);
+        }
+
+        if (gpu_resident) {
+            download();
+            gpu_resident = false;
+        }
+        boids = saved_boids;
+        upload(0, boids.size());
+        time_slice = saved_time_slice;
+    }
+
+    auto Flock::step_cpu(float delta_time, Flock_Kernel step_kernel, Parallel::Worker_Pool& step_pool) -> void
+    {
+        auto boid_count = int(boids.size());
+        if (time_slice && boid_count > 0) {
+            // the search structures cost the same however many boids are steered, the rest of the budget goes to steering;
+            // before the first measurement start small, a full step could be the spike slicing is meant to avoid
+            auto steer_budget = glm::max(frame_budget_ms - slice_prepare_ms, 0.0f);
+            auto budget_count = slice_cost_ms > 0.0f ? int(steer_budget / slice_cost_ms) : 1024;
+            slice_begin = slice_begin % boid_count;
+            slice_count = glm::clamp(budget_count, glm::min(boid_count, 64), boid_count);
+        } else {
+            slice_begin = 0;
+            slice_count = boid_count;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if (use_neighbor_lists) {
+            prepare_neighbor_lists(step_pool);
+        } else {
+            prepare_search(step_kernel);
+        }
+        auto prepared = std::chrono::high_resolution_clock::now();
+        steer(delta_time, step_kernel, step_pool);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        auto prepare_ms = float(std::chrono::duration<double, std::milli>(prepared - start).count());
+        auto step_ms = float(std::chrono::duration<double, std::milli>(end - start).count());
+        cpu_step_ms = cpu_step_ms < 0.0f ? step_ms : 0.9f * cpu_step_ms + 0.1f * step_ms;
+
+        if (slice_count > 0) {
+            // drifting boids are cheap enough to be charged to the steered ones
+            auto cost = (step_ms - prepare_ms) / slice_count;
+            slice_cost_ms = slice_cost_ms < 0.0f ? cost : 0.8f * slice_cost_ms + 0.2f * cost;
+            slice_prepare_ms = 0.8f * slice_prepare_ms + 0.2f * prepare_ms;
+            steer_interval = 0.9f * steer_interval + 0.1f * (float(boid_count) / slice_count);
+            slice_begin = (slice_begin + slice_count) % boid_count;
+        }
+    }
+
+    auto Flock::prepare_neighbor_lists(Parallel::Worker_Pool& step_pool) -> void
+    {
+        auto range = glm::max(visual_range, min_distance);
+        if (neighbor_lists.needs_rebuild(boids, range, skin, glm::max(rebuild_interval, 1))) {
+            neighbor_lists.build(boids, grid, range, skin, step_pool);
+        }
+        neighbor_lists.gather(boids);
+        neighbor_lists.age++;
+        neighbor_lists.step_num++;
+    }
 
-            mappedData = (Boid*)glMapNamedBufferRange(boid_buffer, 0, sizeof(Boid) * boids.size(), GL_MAP_READ_BIT );
+    auto Flock::prepare_search(Flock_Kernel step_kernel) -> void
+    {
+        auto simd = step_kernel == Flock_Kernel::simd;
+        grid.build_soa = simd;
+        if (use_grid) {
+            grid.build(boids, glm::max(visual_range, min_distance));
+        } else if (simd) {
+            // brute force for the soa kernel is a grid with a single cell
+            grid.build(boids, INFINITY);
+        }
+    }
 
-            if (mappedData != nullptr) {
-                for (auto i = 0; i < boids.size(); i++) {
-                    boids[i] = mappedData[i];
+    auto Flock::steer(float delta_time, Flock_Kernel step_kernel, Parallel::Worker_Pool& step_pool) -> void
+    {
+        auto simd = step_kernel == Flock_Kernel::simd;
+
+        // every boid reads boids and writes next_boids, so the result does not depend on thread timing;
+        // contiguous cache line aligned chunks, no two workers write the same line
+        next_boids.resize(boids.size());
+        step_pool.parallel_for(boids.size(), Parallel::cache_line_items<Boid>(), [&](int begin, int end) -> void {
+            for (auto i = begin; i < end; i++) {
+                if (!steered(i)) {
+                    next_boids[i] = boids[i].drift(delta_time);
+                } else if (use_neighbor_lists) {
+                    auto sum = simd ? neighbor_lists.accumulate_soa(i, min_distance, visual_range) : neighbor_lists.accumulate(i, min_distance, visual_range);
+                    next_boids[i] = boids[i].integrate(*this, sum, delta_time);
+                } else if (simd) {
+                    next_boids[i] = boids[i].integrate(*this, grid.accumulate_soa(boids[i].position, min_distance, visual_range), delta_time);
+                } else {
+                    next_boids[i] = boids[i].update(*this, delta_time);
                 }
             }
+        });
+        std::swap(boids, next_boids);
+    }
+
+    auto Flock::step_gpu(float delta_time) -> void
+    {
+        if (boids.empty())
+            return;
 
-            glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        // the tuner times its candidates with its own query, which may not nest inside this one
+        auto timed = !tune_dispatch && step_timer.begin();
+        if (use_grid) {
+            gpu_grid.build(boid_buffers[read_buffer], boids.size(), glm::max(visual_range, min_distance));
+        } else {
+            // brute force reads the unsorted input through the sorted binding
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, boid_buffers[read_buffer]);
         }
-        
 
+        group_size = pick_group_size(delta_time);
+        dispatch_steering(delta_time, group_size);
+        // the next step and the instanced draw both read what this step wrote
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        if (timed)
+            step_timer.end();
+
+        read_buffer = 1 - read_buffer;
+    }
+
+    auto Steering_Program::compile(const std::string& defines) -> void
+    {
+        shader.shader_stage_type_to_path = {{GL_COMPUTE_SHADER, "asset/shaders/Boid.comp"}};
+        shader.compile(defines);
+        boid_num = shader.uniform<int>("boid_num");
+        min_distance = shader.uniform<float>("min_distance");
+        visual_range = shader.uniform<float>("visual_range");
+        avoid_factor = shader.uniform<float>("avoid_factor");
+        center_factor = shader.uniform<float>("center_factor");
+        align_factor = shader.uniform<float>("align_factor");
+        delta_time = shader.uniform<float>("delta_time");
+        use_grid = shader.uniform<bool>("use_grid");
+        cell_num = shader.uniform<int>("cell_num");
+        grid_origin = shader.uniform<glm::vec3>("grid_origin");
+        cell_size = shader.uniform<float>("cell_size");
+        grid_dims = shader.uniform<glm::ivec3>("grid_dims");
     }
 
-    auto Flock::draw(render::Shader& shader) -> void
+    auto Flock::steering_program(int groups_of) -> Steering_Program&
     {
+        if (groups_of == Gpu_Boid_Grid::group_size)
+            return compute_program;
+        auto variant = compute_variants.find(groups_of);
+        if (variant == compute_variants.end()) {
+            variant = compute_variants.emplace(groups_of, Steering_Program{}).first;
+            variant->second.compile(std::format("#define GROUP_SIZE {:d}\n", groups_of) + steering_layout);
+        }
+        return variant->second;
+    }
+
+    auto Flock::dispatch_steering(float delta_time, int groups_of) -> void
+    {
+        auto& program = steering_program(groups_of);
+        auto& shader = program.shader;
         shader.apply();
-        for (auto& boid: boids) {
-            auto model_matrix = boid.get_affine_matrix() * glm::scale(glm::mat4x4(1.0f), glm::vec3(boid_model.scale));
-            shader.setUniformMatrix4fv("world", model_matrix);
-            shader.setUniform1i("import_animation", 0);
-            boid_model.draw();
+        shader.set(program.boid_num, int(boids.size()));
+        shader.set(program.min_distance, min_distance);
+        shader.set(program.visual_range, visual_range);
+        shader.set(program.avoid_factor, avoid_factor);
+        shader.set(program.center_factor, center_factor);
+        shader.set(program.align_factor, align_factor);
+        shader.set(program.delta_time, delta_time);
+        shader.set(program.use_grid, use_grid);
+        shader.set(program.cell_num, gpu_grid.cell_num());
+        shader.set(program.grid_origin, gpu_grid.origin);
+        shader.set(program.cell_size, gpu_grid.cell_size);
+        shader.set(program.grid_dims, gpu_grid.dims);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, boid_buffers[1 - read_buffer]);
+        glDispatchCompute(render::Compute_Tuner::group_count(boids.size(), groups_of), 1, 1);
+    }
+
+    auto Flock::pick_group_size(float delta_time) -> int
+    {
+        auto& tuner = render::Compute_Tuner::shared();
+        auto n = int(boids.size());
+        if (!tune_dispatch) {
+            auto cached = tuner.lookup("boid_steer", n);
+            return cached != 0 && tuner.fits(n, cached) ? cached : Gpu_Boid_Grid::group_size;
+        }
+
+        // Boid.comp keeps two vec3 tiles of GROUP_SIZE in shared memory
+        auto candidates = std::vector<int>{};
+        for (auto size: {32, 64, 128, 256, 512, 1024}) {
+            if (2 * 16 * size <= tuner.max_shared_memory)
+                candidates.emplace_back(size);
+        }
+        auto best = tuner.tune("boid_steer", n, candidates, [&](int size) -> void {
+            dispatch_steering(delta_time, size);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        });
+        tune_dispatch = false;
+        return best != 0 ? best : Gpu_Boid_Grid::group_size;
+    }
+
+    auto Flock::validate_gpu_step(float delta_time) -> float
+    {
+        if (gpu_resident) {
+            download();
+            gpu_resident = false;
+        }
+        upload(0, boids.size());
+        if (compact_boids) {
+            // both sides start from the same half precision rounded state
+            download();
+        }
+
+        // debug only, both readbacks block
+        step_gpu(delta_time);
+        auto cpu_boids = boids;
+        download();
+        auto gpu_boids = std::move(boids);
+        boids = std::move(cpu_boids);
+
+        auto cpu_use_grid = use_grid;
+        auto cpu_time_slice = time_slice;
+        use_grid = true;
+        time_slice = false;
+        step_cpu(delta_time);
+        use_grid = cpu_use_grid;
+        time_slice = cpu_time_slice;
+
+        auto max_error = max_position_error(latest_snapshot(), {gpu_boids.data(), int(gpu_boids.size()), step_id});
+        std::cout << std::format("flock gpu validation {:d} boids: max position error {:g}\n", boids.size(), max_error);
+
+        // continue from the cpu result on both sides
+        upload(0, boids.size());
+        return max_error;
+    }
+
+    auto Flock::copy_parameters(const Flock& other) -> void
+    {
+        use_grid = other.use_grid;
+        kernel = other.kernel;
+        use_neighbor_lists = other.use_neighbor_lists;
+        skin = other.skin;
+        rebuild_interval = other.rebuild_interval;
+        min_distance = other.min_distance;
+        visual_range = other.visual_range;
+        avoid_factor = other.avoid_factor;
+        center_factor = other.center_factor;
+        align_factor = other.align_factor;
+    }
+
+    auto Flock::benchmark_cpu(const std::vector<int>& sizes, bool grid_search, Flock_Kernel bench_kernel, bool neighbor_lists) const -> std::vector<Bench_Sample>
+    {
+        constexpr auto max_steps = 20;
+        constexpr auto time_per_size = 1.0;
+
+        auto samples = std::vector<Bench_Sample>{};
+        auto bench_rng = std::mt19937{seed};
+        for (auto size: sizes) {
+            auto bench = Flock{};
+            bench.copy_parameters(*this);
+            bench.use_grid = grid_search;
+            bench.kernel = bench_kernel;
+            bench.use_neighbor_lists = neighbor_lists;
+            for (auto i = 0; i < size; i++) {
+                bench.boids.emplace_back(random_boid(bench_rng, 2.0f));
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            auto steps{0};
+            auto elapsed{0.0};
+            while (steps < max_steps && elapsed < time_per_size) {
+                bench.step_cpu(1.0f / 60.0f);
+                steps++;
+                elapsed = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+            samples.emplace_back(size, float(steps / elapsed));
+            auto search = neighbor_lists ? "neighbor lists" : grid_search ? "grid" : "brute force";
+            std::cout << std::format("flock cpu bench {:s} {:s} {:d} boids: {:.2f} steps/s\n", bench_kernel == Flock_Kernel::simd ? "simd" : "scalar", search, size, steps / elapsed);
+
+            // the rest of the curve would only get slower
+            if (steps / elapsed < 1.0)
+                break;
+        }
+        return samples;
+    }
+
+    auto Flock::replay(int boid_count, int steps, Parallel::Worker_Pool& worker_pool) const -> std::vector<Flock_Checksum>
+    {
+        auto replay_flock = Flock{};
+        replay_flock.worker_pool = &worker_pool;
+        replay_flock.copy_parameters(*this);
+        replay_flock.rng.seed(seed);
+        for (auto i = 0; i < boid_count; i++) {
+            replay_flock.boids.emplace_back(random_boid(replay_flock.rng, 0.5f));
+        }
+
+        auto checksums = std::vector<Flock_Checksum>{};
+        for (auto i = 0; i < steps; i++) {
+            replay_flock.step_cpu(1.0f / 60.0f);
+            replay_flock.step_id++;
+            checksums.emplace_back(checksum(replay_flock.latest_snapshot()));
+        }
+        return checksums;
+    }
+
+    auto Flock::latest_snapshot() const -> Flock_Snapshot
+    {
+        if (!gpu_resident) {
+            return {boids.data(), int(boids.size()), step_id};
+        }
+        if (compact_boids) {
+            if (snapshot_boids.empty())
+                return {};
+            return {snapshot_boids.data(), int(snapshot_boids.size()), snapshot_step};
+        }
+        auto slot = readback.latest();
+        if (slot == nullptr) {
+            return {};
+        }
+        return {reinterpret_cast<const Boid*>(slot->mapped), int(slot->size / sizeof(Boid)), slot->frame};
+    }
+
+    auto Flock::draw(const glm::mat4& view_proj, const glm::vec3& cam_pos) -> void
+    {
+        auto culled = frustum_cull && !boids.empty();
+        if (culled)
+            culler.cull(current_buffer(), boids.size(), boid_model.uniform_mesh.indices.size(), cull_radius, view_proj);
+
+        draw_shader.apply();
+        draw_shader.set(draw_uniforms.view_proj, view_proj);
+        draw_shader.set(draw_uniforms.cam_pos, cam_pos);
+        draw_shader.set(draw_uniforms.boid_scale, boid_model.scale);
+        draw_shader.set(draw_uniforms.culled, culled);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, current_buffer());
+        if (culled) {
+            boid_model.draw_indirect();
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        } else {
+            boid_model.draw_instanced(boids.size());
         }
     }
 } // namespace Group_Animation
@@ -3,8 +3,19 @@
 #include "animation.hpp"
 #include "mesh.hpp"
 #include "render.hpp"
+#include "gpu-readback.hpp"
+#include "gpu-timer.hpp"
+#include "compute-tuner.hpp"
+#include "worker-pool.hpp"
+#include "flock-backend.hpp"
 
 #include <glm/glm.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <unordered_map>
 
 namespace Group_Animation
 {
@@ -15,6 +26,28 @@ namespace Group_Animation
 
     struct Flock;
 
+    // neighbor sums a steering kernel hands to Boid::integrate
+    struct Steering_Sum final
+    {
+        glm::vec4 move{};
+        glm::vec4 center{};
+        glm::vec4 align{};
+        int neighbor_num{};
+
+        auto add(const glm::vec4& position, const glm::vec4& other_position, const glm::vec4& other_velocity, float min_distance, float visual_range) -> void
+        {
+            auto dis = glm::distance(position, other_position);
+            if (dis < min_distance) {
+                move += position - other_position;
+            }
+            if (dis < visual_range) {
+                center += other_position;
+                align += other_velocity;
+                neighbor_num++;
+            }
+        }
+    };
+
     struct Boid final
     {
         glm::vec4 position{};
@@ -23,26 +56,454 @@ namespace Group_Animation
         
         auto strategy() -> void;
 
-        auto get_affine_matrix() -> glm::mat4x4;
+        // next state, reads only this boid and the flock's read buffer
+        auto update(const Flock& flock, float delta_time) const -> Boid;
+
+        auto integrate(const Flock& flock, const Steering_Sum& sum, float delta_time) const -> Boid;
+
+        // moves along the last velocity, for boids a time-sliced step does not steer
+        auto drift(float delta_time) const -> Boid
+        {
+            auto next = *this;
+            next.position += velocity * delta_time;
+            return next;
+        }
+    };
+
+    // Boid is uploaded as is, it has to match the std430 Boid in asset/shaders/Boid_Layout.glsl
+    static_assert(sizeof(Boid) == 48, "std430 Boid stride is 48");
+    static_assert(offsetof(Boid, position) == 0, "std430 Boid::position offset");
+    static_assert(offsetof(Boid, rotation) == 16, "std430 Boid::rotation offset");
+    static_assert(offsetof(Boid, velocity) == 32, "std430 Boid::velocity offset");
+    static_assert(sizeof(glm::quat) == 16 && offsetof(glm::quat, x) == 0, "rotation is stored x y z w");
+
+    // Gpu encoding with COMPACT_BOID defined: float3 position, half4 rotation, half3 velocity.
+    struct Compact_Boid final
+    {
+        float position[3]{};
+        std::uint32_t rotation[2]{};
+        std::uint32_t velocity[2]{};
+
+        static auto encode(const Boid& boid) -> Compact_Boid;
+
+        auto decode() const -> Boid;
+    };
+
+    static_assert(sizeof(Compact_Boid) == 28, "std430 Boid_Data stride is 28 with COMPACT_BOID");
+    static_assert(offsetof(Compact_Boid, rotation) == 12, "std430 Boid_Data::rotation offset");
+    static_assert(offsetof(Compact_Boid, velocity) == 20, "std430 Boid_Data::velocity offset");
+
+    using Boid_Array = std::vector<Boid, Parallel::Cache_Aligned_Allocator<Boid>>;
+
+    // Uniform grid rebuilt every step. Boids are counting-sorted by cell, so every cell is a contiguous
+    // range of sorted_position / sorted_velocity and a neighbor query only walks the 27 adjacent cells.
+    // Steering reads these sorted copies, never the boids being written.
+    struct Boid_Grid final
+    {
+        glm::vec3 origin{};
+        float cell_size{1.0f};
+        glm::ivec3 dims{1, 1, 1};
+
+        // cell c holds sorted entries [cell_start[c], cell_start[c + 1])
+        std::vector<int> cell_start{};
+        std::vector<int> boid_cell{};
+        std::vector<glm::vec4> sorted_position{};
+        std::vector<glm::vec4> sorted_velocity{};
+        // boid index of every sorted entry
+        std::vector<int> sorted_id{};
+
+        // the same sorted flock as separate component arrays, only filled when build_soa is set
+        using Float_Array = std::vector<float, Parallel::Cache_Aligned_Allocator<float>>;
+        bool build_soa{false};
+        Float_Array px{}, py{}, pz{};
+        Float_Array vx{}, vy{}, vz{};
+
+        auto build(const Boid_Array& boids, float range) -> void;
+
+        // vectorized neighbor sums over the soa arrays, see flock-simd.cpp
+        auto accumulate_soa(const glm::vec3& p, float min_distance, float visual_range) const -> Steering_Sum;
+
+        // appends the sorted index of every entry closer than range to p, also from the soa arrays
+        auto collect_soa(const glm::vec3& p, float range, std::vector<int>& out) const -> void;
+
+        auto cell_coord(const glm::vec3& p) const -> glm::ivec3
+        {
+            return glm::clamp(glm::ivec3((p - origin) / cell_size), glm::ivec3(0), dims - 1);
+        }
+
+        auto cell_index(const glm::ivec3& c) const -> int
+        {
+            return c.x + dims.x * (c.y + dims.y * c.z);
+        }
+
+        // visit(begin, end) once per row of adjacent cells, the x run of a row is contiguous in the sorted arrays
+        template <typename Visit>
+        auto for_each_neighbor_range(const glm::vec3& p, Visit&& visit) const -> void
+        {
+            auto c = cell_coord(p);
+            auto lo = glm::max(c - 1, glm::ivec3(0));
+            auto hi = glm::min(c + 1, dims - 1);
+            for (auto z = lo.z; z <= hi.z; z++) {
+                for (auto y = lo.y; y <= hi.y; y++) {
+                    visit(cell_start[cell_index({lo.x, y, z})], cell_start[cell_index({hi.x, y, z}) + 1]);
+                }
+            }
+        }
+
+        template <typename Visit>
+        auto for_each_neighbor(const glm::vec3& p, Visit&& visit) const -> void
+        {
+            for_each_neighbor_range(p, [&](int begin, int end) -> void {
+                for (auto i = begin; i < end; i++) {
+                    visit(sorted_position[i], sorted_velocity[i]);
+                }
+            });
+        }
+    };
+
+    // Verlet lists: every boid inside the search range plus a skin at the last rebuild.
+    // Until some boid has moved half the skin, no pair can have come into range unseen,
+    // so the steps in between read the lists instead of searching the grid.
+    // Lists keep the grid's sorted order: each step gathers the flock into that order once,
+    // so list entries of nearby boids read nearby memory.
+    struct Neighbor_Lists final
+    {
+        // neighbors of sorted slot a are slots[list_start[a], list_start[a + 1])
+        std::vector<int> list_start{};
+        std::vector<int> slots{};
+
+        // sorted slot to boid index and back, fixed between rebuilds
+        std::vector<int> order{};
+        std::vector<int> slot_of{};
+
+        std::vector<glm::vec4> reference_position{};
+        // range and skin the lists were searched with, a change in either invalidates them
+        float built_range{-1.0f};
+        float built_skin{-1.0f};
+
+        // scratch for the rebuild, one list per block of sorted slots
+        std::vector<std::vector<int>> block_slots{};
+
+        // this step's flock in sorted order
+        Boid_Grid::Float_Array px{}, py{}, pz{};
+        Boid_Grid::Float_Array vx{}, vy{}, vz{};
+
+        // steps since the last rebuild
+        int age{};
+
+        std::uint64_t step_num{};
+        std::uint64_t rebuild_num{};
+
+        auto needs_rebuild(const Boid_Array& boids, float range, float skin, int rebuild_interval) const -> bool;
+
+        // searches grid with range + skin in parallel
+        auto build(const Boid_Array& boids, Boid_Grid& grid, float range, float skin, Parallel::Worker_Pool& pool) -> void;
+
+        auto gather(const Boid_Array& boids) -> void;
+
+        auto accumulate(int i, float min_distance, float visual_range) const -> Steering_Sum
+        {
+            auto a = slot_of[i];
+            auto position = glm::vec4{px[a], py[a], pz[a], 0.0f};
+            auto sum = Steering_Sum{};
+            for (auto k = list_start[a]; k < list_start[a + 1]; k++) {
+                auto b = slots[k];
+                sum.add(position, {px[b], py[b], pz[b], 0.0f}, {vx[b], vy[b], vz[b], 0.0f}, min_distance, visual_range);
+            }
+            return sum;
+        }
+
+        // gathers 8 list entries per iteration, see flock-simd.cpp
+        auto accumulate_soa(int i, float min_distance, float visual_range) const -> Steering_Sum;
+
+        auto rebuild_rate() const -> float
+        {
+            return step_num > 0 ? float(rebuild_num) / float(step_num) : 0.0f;
+        }
+    };
+
+    // Gpu counterpart of Boid_Grid, Boid_Grid.comp bins, prefix-sums and sorts the flock by (cell, id).
+    // Cells cover a fixed box around the simulation bounds, boids outside are clamped into border cells.
+    struct Gpu_Boid_Grid final
+    {
+        static constexpr int group_size = 256;
+        static constexpr int max_dim = 128;
+        static constexpr float half_extent = 2.5f;
+
+        render::Shader shader;
+
+        // Boid_Grid.comp's uniforms, resolved in init
+        struct Uniforms final
+        {
+            render::Uniform_Handle<int> boid_num{};
+            render::Uniform_Handle<int> cell_num{};
+            render::Uniform_Handle<glm::vec3> grid_origin{};
+            render::Uniform_Handle<float> cell_size{};
+            render::Uniform_Handle<glm::ivec3> grid_dims{};
+            render::Uniform_Handle<int> grid_pass{};
+        } uniforms{};
+
+        unsigned int sorted_boid_buffer{};
+        unsigned int sorted_id_buffer{};
+        unsigned int cell_start_buffer{};
+        unsigned int boid_cell_buffer{};
+        unsigned int block_sum_buffer{};
+
+        int boid_capacity{};
+        int cell_capacity{};
+
+        // bytes per sorted boid, follows the flock's encoding
+        int boid_stride{sizeof(Boid)};
+
+        glm::vec3 origin{-half_extent};
+        float cell_size{1.0f};
+        glm::ivec3 dims{1, 1, 1};
+
+        auto init(const std::string& layout) -> void;
+
+        auto release() -> void;
+
+        auto reserve(int boid_num, int cell_num) -> void;
+
+        auto cell_num() const -> int
+        {
+            return dims.x * dims.y * dims.z;
+        }
+
+        // leaves the sorted flock on binding 2 and 3 and the cell starts on binding 4
+        auto build(unsigned int boids_in, int boid_num, float range) -> void;
+    };
+
+    // DrawElementsIndirectCommand as glDrawElementsIndirect reads it
+    struct Draw_Elements_Command final
+    {
+        std::uint32_t index_count{};
+        std::uint32_t instance_count{};
+        std::uint32_t first_index{};
+        std::int32_t base_vertex{};
+        std::uint32_t base_instance{};
+    };
+
+    static_assert(sizeof(Draw_Elements_Command) == 20);
+
+    // Gpu frustum culling for the instanced boid draw, Boid_Cull.comp tests every boid's bounding sphere
+    // against the planes of viewProj, compacts the visible ids and counts them into the draw command.
+    // Nothing waits on the count: it comes back a few frames late through a readback ring, for display only.
+    struct Gpu_Boid_Culler final
+    {
+        static constexpr int group_size = 256;
+
+        render::Shader shader;
+
+        // Boid_Cull.comp's uniforms, resolved in init
+        struct Uniforms final
+        {
+            render::Uniform_Handle<int> boid_num{};
+            render::Uniform_Handle<float> radius{};
+            render::Uniform_Handle<glm::vec4> planes{};
+        } uniforms{};
+
+        unsigned int visible_buffer{};
+        unsigned int command_buffer{};
+
+        int boid_capacity{};
+
+        render::Readback_Ring count_readback{};
+
+        std::uint64_t cull_id{};
+
+        // boids that passed the latest cull read back so far, -1 before the first one lands
+        int visible_num{-1};
+
+        auto init(const std::string& layout) -> void;
+
+        auto release() -> void;
+
+        auto reserve(int boid_num) -> void;
+
+        // leaves the visible ids on binding 5 and the command on GL_DRAW_INDIRECT_BUFFER
+        auto cull(unsigned int boids_in, int boid_num, int index_num, float radius, const glm::mat4& view_proj) -> void;
+
+        // left, right, bottom, top, near, far, normalized so the w term is a distance
+        static auto frustum_planes(const glm::mat4& view_proj) -> std::array<glm::vec4, 6>;
+    };
+
+    struct Bench_Sample final
+    {
+        int boid_num{};
+        float steps_per_second{};
+    };
+
+    // boids is null when no snapshot has completed yet
+    struct Flock_Snapshot final
+    {
+        const Boid* boids{nullptr};
+        int boid_num{};
+        std::uint64_t step{};
+    };
 
-        auto update(Flock& flock, float delta_time) -> void;
+    // hash is bit exact over position, rotation and velocity, the sums allow comparing within a tolerance
+    struct Flock_Checksum final
+    {
+        std::uint64_t step{};
+        std::uint64_t hash{};
+        glm::dvec3 position_sum{};
+        glm::dvec3 velocity_sum{};
+    };
+
+    auto checksum(const Flock_Snapshot& snapshot) -> Flock_Checksum;
+
+    auto max_position_error(const Flock_Snapshot& a, const Flock_Snapshot& b) -> float;
+
+    // Boid.comp with its uniform handles, which differ between GROUP_SIZE variants
+    struct Steering_Program final
+    {
+        render::Shader shader;
+
+        render::Uniform_Handle<int> boid_num{};
+        render::Uniform_Handle<float> min_distance{};
+        render::Uniform_Handle<float> visual_range{};
+        render::Uniform_Handle<float> avoid_factor{};
+        render::Uniform_Handle<float> center_factor{};
+        render::Uniform_Handle<float> align_factor{};
+        render::Uniform_Handle<float> delta_time{};
+        render::Uniform_Handle<bool> use_grid{};
+        render::Uniform_Handle<int> cell_num{};
+        render::Uniform_Handle<glm::vec3> grid_origin{};
+        render::Uniform_Handle<float> cell_size{};
+        render::Uniform_Handle<glm::ivec3> grid_dims{};
+
+        // defines go right after #version, e.g. GROUP_SIZE and the Boid layout
+        auto compile(const std::string& defines) -> void;
     };
 
     struct Flock final
     {
-        std::vector<Boid> boids{};
+        // double buffered cpu state: a step reads boids, writes next_boids, then swaps
+        Boid_Array boids{};
+        Boid_Array next_boids{};
+
+        unsigned int seed{};
+
+        std::mt19937 rng{};
+
+        // null uses Parallel::Worker_Pool::shared()
+        Parallel::Worker_Pool* worker_pool{nullptr};
 
         assimp_model::Model boid_model;
 
-        render::Shader compute_shader;
+        Steering_Program compute_program;
 
-        unsigned int boid_buffer{};
+        // Boid.comp compiled with GROUP_SIZE other than the default, built on first use
+        std::unordered_map<int, Steering_Program> compute_variants{};
 
-        bool enable_gpu{true};
+        // Boid_Layout.glsl as the flock shaders were last compiled with
+        std::string steering_layout{};
 
-        int boid_num{10};
+        // workgroup size of the steering dispatch, from the compute tuner cache
+        int group_size{Gpu_Boid_Grid::group_size};
+
+        // time the candidate group sizes on the next gpu step and replace the cached winner, clears itself
+        bool tune_dispatch{false};
+
+        render::Shader draw_shader;
+
+        // Boid.vert's uniforms, resolved in compile_shaders
+        struct Draw_Uniforms final
+        {
+            render::Uniform_Handle<glm::mat4> view_proj{};
+            render::Uniform_Handle<glm::vec3> cam_pos{};
+            render::Uniform_Handle<float> boid_scale{};
+            render::Uniform_Handle<bool> culled{};
+        } draw_uniforms{};
+
+        // ping-pong pair, compute reads boid_buffers[read_buffer] and writes the other one
+        unsigned int boid_buffers[2]{};
+
+        int read_buffer{0};
+
+        // boids both buffers can hold, grows geometrically
+        int boid_capacity{};
+
+        // gpu buffers hold Compact_Boid instead of Boid, switch with set_compact
+        bool compact_boids{false};
+
+        std::vector<Compact_Boid> compact_staging{};
+
+        // decoded copy of the latest compact readback slot
+        Boid_Array snapshot_boids{};
+        std::uint64_t snapshot_step{};
+
+        // grid build plus steering, GL_TIME_ELAPSED
+        render::Gpu_Timer step_timer{};
+
+        // upper bound for boid_num, 16384 workgroups of 256 stay below the guaranteed 65535 per dispatch
+        static constexpr int max_boid_num = 1 << 22;
+
+        // the newest boid state only lives on the gpu, boids is stale until read back
+        bool gpu_resident{false};
+
+        // scalar cpu, threaded cpu, simd cpu, gpu compute; filled by init
+        std::vector<std::unique_ptr<Flock_Backend>> backends{};
+
+        int backend{0};
+
+        // what auto_backend runs before calibrate, the gpu one
+        int default_backend{0};
+
+        // follow calibration.choose(boid_num) instead of a fixed backend, default_backend until calibrate has run
+        bool auto_backend{true};
+
+        Backend_Calibration calibration{};
+
+        // cpu neighbor search through grid instead of testing every pair
+        bool use_grid{true};
+
+        // kernel and pool for steps outside a backend: validation, benchmarks, replays
+        Flock_Kernel kernel{Flock_Kernel::scalar};
+
+        // cpu steps read cached neighbor lists, rebuilt every rebuild_interval steps or once a boid moved skin / 2
+        bool use_neighbor_lists{false};
+        float skin{0.05f};
+        int rebuild_interval{10};
+
+        Neighbor_Lists neighbor_lists{};
 
-        Boid* mappedData{nullptr};
+        // smoothed wall time of step_cpu, -1 until the first step
+        float cpu_step_ms{-1.0f};
+
+        // Time slicing: a cpu step steers only boids [slice_begin, slice_begin + slice_count) modulo the flock,
+        // sized from the measured cost per steered boid to fit what the grid or list rebuild leaves of frame_budget_ms.
+        // The window rotates every step and the other boids drift along their last velocity.
+        bool time_slice{false};
+        float frame_budget_ms{4.0f};
+        int slice_begin{0};
+        int slice_count{0};
+        float slice_cost_ms{-1.0f};
+        float slice_prepare_ms{};
+        // smoothed boid_num / slice_count, 1 when every boid is steered every step
+        float steer_interval{1.0f};
+
+        Boid_Grid grid{};
+
+        Gpu_Boid_Culler culler{};
+
+        // draw only boids whose bounding sphere touches the view frustum
+        bool frustum_cull{true};
+
+        // boid_model.bounding_radius() times its scale, set by init
+        float cull_radius{};
+
+        Gpu_Boid_Grid gpu_grid{};
+
+        // opt-in async copy of the gpu flock for cpu consumers, one or two steps behind
+        bool enable_readback{false};
+
+        render::Readback_Ring readback{};
+
+        std::uint64_t step_id{};
+
+        int boid_num{10};
 
         float min_distance{0.3f};
         float avoid_factor{0.05f};
@@ -52,9 +513,99 @@ namespace Group_Animation
 
         auto init(const std::string boid_config_path, const std::string flock_config_path) -> void;
 
+        // buffers, queries and readback rings, while the gl context is still alive
+        auto release() -> void;
+
         auto update(float delta_time) -> void;
 
-        auto draw(render::Shader& shader) -> void;
+        // grows the gpu buffers to hold boid_count boids, the current state is copied on the gpu
+        auto reserve(int boid_count) -> void;
+
+        // recompiles the flock shaders for the other encoding and re-uploads the flock, blocks once
+        auto set_compact(bool compact) -> void;
+
+        auto compile_shaders() -> void;
+
+        // boids [first, first + count) from the cpu state into the current gpu buffer, in the gpu encoding
+        auto upload(int first, int count) -> void;
+
+        // blocking copy of the current gpu buffer into boids
+        auto download() -> void;
+
+        auto boid_stride() const -> int
+        {
+            return compact_boids ? sizeof(Compact_Boid) : sizeof(Boid);
+        }
+
+        // one step on backend b, moving the state between boids and the gpu buffers when residency changes
+        auto advance(Flock_Backend& b, float delta_time) -> void;
+
+        // times every backend at each size from the same seeded flock, the current flock is restored afterwards
+        auto calibrate(const std::vector<int>& sizes, float seconds_per_run) -> void;
+
+        auto uses_gpu() const -> bool
+        {
+            return !backends.empty() && backends[backend]->on_gpu();
+        }
+
+        // a backend's step, the flock's own kernel and pool stay as they are
+        auto step_cpu(float delta_time, Flock_Kernel step_kernel, Parallel::Worker_Pool& step_pool) -> void;
+
+        auto step_cpu(float delta_time) -> void
+        {
+            step_cpu(delta_time, kernel, pool());
+        }
+
+        // rebuilds the neighbor lists when due and gathers this step's flock
+        auto prepare_neighbor_lists(Parallel::Worker_Pool& step_pool) -> void;
+
+        // grid for the search, or a single cell grid for simd brute force
+        auto prepare_search(Flock_Kernel step_kernel) -> void;
+
+        // steers the current slice through the prepared structures, drifts the rest
+        auto steer(float delta_time, Flock_Kernel step_kernel, Parallel::Worker_Pool& step_pool) -> void;
+
+        auto steered(int i) const -> bool
+        {
+            auto offset = i - slice_begin;
+            return (offset < 0 ? offset + int(boids.size()) : offset) < slice_count;
+        }
+
+        auto step_gpu(float delta_time) -> void;
+
+        // steering pass only, reads binding 2 and writes the other buffer, so repeating it is harmless
+        auto dispatch_steering(float delta_time, int groups_of) -> void;
+
+        auto steering_program(int groups_of) -> Steering_Program&;
+
+        auto pick_group_size(float delta_time) -> int;
+
+        // one gpu step and one cpu grid step from the same state, returns the largest position difference
+        auto validate_gpu_step(float delta_time) -> float;
+
+        // search and steering settings, for the throwaway flocks of benchmarks and replays
+        auto copy_parameters(const Flock& other) -> void;
+
+        // cpu steps per second for each flock size, boids spread over the simulation bounds
+        auto benchmark_cpu(const std::vector<int>& sizes, bool grid_search, Flock_Kernel bench_kernel = Flock_Kernel::scalar, bool neighbor_lists = false) const -> std::vector<Bench_Sample>;
+
+        auto draw(const glm::mat4& view_proj, const glm::vec3& cam_pos) -> void;
+
+        // most recent completed state, never waits on the gpu
+        auto latest_snapshot() const -> Flock_Snapshot;
+
+        // headless cpu run from the seeded initial state, for comparing thread counts and backends
+        auto replay(int boid_count, int steps, Parallel::Worker_Pool& worker_pool) const -> std::vector<Flock_Checksum>;
+
+        auto pool() const -> Parallel::Worker_Pool&
+        {
+            return worker_pool != nullptr ? *worker_pool : Parallel::Worker_Pool::shared();
+        }
+
+        auto current_buffer() const -> unsigned int
+        {
+            return boid_buffers[read_buffer];
+        }
     };
 } // namespace Group_Animation
 
@@ -1,6 +1,7 @@
 #include "mesh.hpp"
 #include <format>
 #include <queue>
+#include <algorithm>
 
 #include <nlohmann/json.hpp>
 #include <fstream>
@@ -247,9 +248,16 @@ namespace assimp_model
             }
         };
 
-        if (import_animation)
+        if (import_animation) {
             processSkeleton();
 
+            // optional, [{"track": 1, "reference_track": 0}, ...]
+            if (auto additive_tracks = config.find("additive_tracks"); additive_tracks != config.end()) {
+                for (auto& additive: additive_tracks.value())
+                    make_additive(additive.find("track").value(), additive.find("reference_track").value());
+            }
+        }
+
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
         // uniform_mesh.setup_mesh();
@@ -435,11 +443,63 @@ namespace assimp_model
             }
 
             current_frame[i].position = trans;
-            auto tmp_quat = weights[0] + weights[1] > 0.0f ? glm::slerp(rotation[0], rotation[1], weights[1] / (weights[0] + weights[1])) : glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
-            current_frame[i].rotation = glm::slerp(tmp_quat, rotation[2], weights[2] / (weights[0] + weights[1] + weights[2]));
+            // running slerp, each rotation pulls by its share of the weight seen so far
+            auto blended_rotation = rotation[0];
+            auto weight_sum = weights[0];
+            for (int j = 1; j < weights.size(); j++) {
+                weight_sum += weights[j];
+                if (weight_sum > 0.0f)
+                    blended_rotation = glm::slerp(blended_rotation, rotation[j], weights[j] / weight_sum);
+            }
+            current_frame[i].rotation = blended_rotation;
             current_frame[i].scale = scale;
         }
 
+        upload_pose(current_frame);
+    }
+
+    auto Model::make_additive(int track_id, int reference_track) -> int
+    {
+        auto track_num = int(tracks.size());
+        if (track_id < 0 || track_id >= track_num || reference_track < 0 || reference_track >= track_num) {
+            std::cout << std::format("additive track {:d} against {:d} skipped, the model has {:d} tracks\n", track_id, reference_track, track_num);
+            return -1;
+        }
+
+        auto delta = tracks[track_id];
+        auto& reference = tracks[reference_track];
+        delta.track_name += "_additive";
+        delta.additive = true;
+
+        for (auto i = 0; i < delta.channels.size(); i++) {
+            auto& channel = delta.channels[i];
+            auto& reference_channel = reference.channels[i];
+            // nothing to subtract, so the bone adds nothing instead of its absolute transform
+            if (reference_channel.rotations.empty()) {
+                std::fill(channel.positions.begin(), channel.positions.end(), glm::vec3(0.0f));
+                std::fill(channel.rotations.begin(), channel.rotations.end(), glm::identity<glm::quat>());
+                std::fill(channel.scales.begin(), channel.scales.end(), glm::vec3(1.0f));
+                continue;
+            }
+            auto reference_position = reference_channel.positions[0];
+            auto reference_rotation_inverse = glm::inverse(reference_channel.rotations[0]);
+            auto reference_scale = reference_channel.scales[0];
+            for (auto key_id = 0; key_id < channel.rotations.size(); key_id++) {
+                channel.positions[key_id] -= reference_position;
+                channel.rotations[key_id] = channel.rotations[key_id] * reference_rotation_inverse;
+                channel.scales[key_id] /= reference_scale;
+            }
+        }
+
+        std::cout << std::format("additive track {:s} against {:s}\n", delta.track_name, reference.track_name);
+        tracks.emplace_back(std::move(delta));
+        return int(tracks.size()) - 1;
+    }
+
+    auto Model::upload_pose(const std::vector<Bone_Trans>& current_frame) -> void
+    {
+        auto bone_num = bone_name_to_id.size();
+
         // auto channel_num = channels.size();
 
         std::vector<glm::mat4x4> tmp_anim_pose_frames{};
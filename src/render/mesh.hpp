@@ -63,6 +63,8 @@ namespace assimp_model
         float duration{};
         float frame_per_second{1};
         std::vector<Channel> channels{};
+        // channels hold deltas against a reference pose, see Model::make_additive
+        bool additive{false};
         // unsigned int track_anim_texture{};
     };
 
@@ -90,6 +92,21 @@ namespace assimp_model
             glBindVertexArray(0);
         }
 
+        auto draw_instanced(int instance_num)  -> void
+        {
+            glBindVertexArray(vao);
+            glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, instance_num);
+            glBindVertexArray(0);
+        }
+
+        // arguments come from the DrawElementsIndirectCommand at offset 0 of the bound GL_DRAW_INDIRECT_BUFFER
+        auto draw_indirect()  -> void
+        {
+            glBindVertexArray(vao);
+            glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr);
+            glBindVertexArray(0);
+        }
+
         auto append_mesh(std::vector<Vertex>& append_vertices, std::vector<unsigned int>& append_indices, std::vector<glm::vec2>& append_driven_bone_offset, std::vector<std::vector<driven_bone>>& append_driven_bone_and_weight)  -> void;
 
         auto setup_mesh(bool import_animation)  -> void;
@@ -129,6 +146,25 @@ namespace assimp_model
             uniform_mesh.draw();
         }
 
+        auto draw_instanced(int instance_num)  -> void
+        {
+            uniform_mesh.draw_instanced(instance_num);
+        }
+
+        auto draw_indirect()  -> void
+        {
+            uniform_mesh.draw_indirect();
+        }
+
+        // distance of the farthest vertex from the model origin, before scale
+        auto bounding_radius() const -> float
+        {
+            auto radius = 0.0f;
+            for (auto& vertex: uniform_mesh.vertices)
+                radius = glm::max(radius, glm::length(vertex.position));
+            return radius;
+        }
+
         auto load_with_config(std::string const path)  -> bool;
 
         auto processNode(aiNode *node, const aiScene *scene) -> void;
@@ -139,6 +175,12 @@ namespace assimp_model
 
         auto create_anim_matrix_texure(std::vector<int>& frame_id, std::vector<int>& track_id, float left_weight, float right_weight, std::vector<float>& weights) -> void;
 
+        // appends track_id as deltas against frame 0 of reference_track and returns the new track, -1 for a bad index
+        auto make_additive(int track_id, int reference_track) -> int;
+
+        // local bone transforms to world matrices in track_anim_texture
+        auto upload_pose(const std::vector<Bone_Trans>& current_frame) -> void;
+
         auto bind_textures() -> void;
 
         auto setup_model() -> void
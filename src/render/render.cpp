@@ -35,11 +35,14 @@ namespace render
                 shader_stream << inFile.rdbuf();
                 filetext = shader_stream.str();
                 inFile.close();
-                return filetext.insert(14, marco);
+                // right after the #version line, whatever its line ending
+                auto version_end = filetext.find('\n');
+                return filetext.insert(version_end == std::string::npos ? filetext.size() : version_end + 1, marco);
             }
         };
 
-        program_id = glCreateProgram();
+        // the old program keeps running until the new one links, a failed reload changes nothing
+        auto program = glCreateProgram();
         for (auto &t2p : shader_stage_type_to_path)
         {
             auto shader_stage_type = t2p.first;
@@ -60,166 +63,95 @@ namespace render
                 char infoLog[512];
                 glGetShaderInfoLog(shader_obj, 512, nullptr, infoLog);
                 std::cout << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+                glDeleteShader(shader_obj);
+                glDeleteProgram(program);
                 return false;
             }
 
-            glAttachShader(program_id, shader_obj);
+            glAttachShader(program, shader_obj);
             glDeleteShader(shader_obj);
         }
 
-        glLinkProgram(program_id);
+        glLinkProgram(program);
 
         auto status{GL_TRUE};
-        glGetProgramiv(program_id, GL_LINK_STATUS, &status);
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
 
         if (status == GL_FALSE)
         {
             // std::cout << "shader link error" << std::endl;
             char infoLog[512];
-            glGetProgramInfoLog(program_id, 512, nullptr, infoLog);
+            glGetProgramInfoLog(program, 512, nullptr, infoLog);
             std::cout << "ERROR::SHADER::LINK_FAILED\n" << infoLog << std::endl;
+            glDeleteProgram(program);
             return false;
         }
 
+        // 0 is silently ignored, the first compile has nothing to delete
+        glDeleteProgram(program_id);
+        program_id = program;
+        load_uniform_locations();
         return true;
     }
 
     auto Shader::setUniform1b(const std::string &uniform_name, bool value) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform1i(program_id, uniformsLocations[uniform_name], value ? 1 : 0);
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniform1i(program_id, uniformsLocations[uniform_name], value ? 1 : 0);
-        }
+        glProgramUniform1i(program_id, uniform_location(uniform_name), value ? 1 : 0);
     }
 
     auto Shader::setUniform1f(const std::string &uniform_name, float value) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform1f(program_id, uniformsLocations[uniform_name], value);
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniform1f(program_id, uniformsLocations[uniform_name], value);
-        }
+        glProgramUniform1f(program_id, uniform_location(uniform_name), value);
     }
 
     auto Shader::setUniform1i(const std::string &uniform_name, int value) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform1i(program_id, uniformsLocations[uniform_name], value);
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniform1i(program_id, uniformsLocations[uniform_name], value);
-        }
+        glProgramUniform1i(program_id, uniform_location(uniform_name), value);
     }
 
     auto Shader::setUniform1ui(const std::string &uniform_name, unsigned int value) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform1ui(program_id, uniformsLocations.at(uniform_name), value);
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniform1ui(program_id, uniformsLocations[uniform_name], value);
-        }
+        glProgramUniform1ui(program_id, uniform_location(uniform_name), value);
     }
 
     auto Shader::setUniform1fv(const std::string &uniform_name, GLsizei count, float *value) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform1fv(program_id, uniformsLocations[uniform_name], count, value);
-        }
-        else
-        {
-            if (getUniformLocation(uniform_name))
-            {
-                glProgramUniform1fv(program_id, uniformsLocations[uniform_name], count, value);
-            }
-        }
+        glProgramUniform1fv(program_id, uniform_location(uniform_name), count, value);
     }
 
     auto Shader::setUniform1iv(const std::string &uniform_name, GLsizei count, int *value) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform1iv(program_id, uniformsLocations[uniform_name], count, value);
-        }
-        else
-        {
-            if (getUniformLocation(uniform_name))
-            {
-                glProgramUniform1iv(program_id, uniformsLocations[uniform_name], count, value);
-            }
-        }
+        glProgramUniform1iv(program_id, uniform_location(uniform_name), count, value);
     }
 
     auto Shader::setUniform2fv(const std::string &uniform_name, const glm::vec2 &vector) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform2fv(program_id, uniformsLocations[uniform_name], 1, glm::value_ptr(vector));
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniform2fv(program_id, uniformsLocations[uniform_name], 1, glm::value_ptr(vector));
-        }
+        glProgramUniform2fv(program_id, uniform_location(uniform_name), 1, glm::value_ptr(vector));
     }
 
     auto Shader::setUniform3fv(const std::string &uniform_name, const glm::vec3 &vector) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform3fv(program_id, uniformsLocations[uniform_name], 1, glm::value_ptr(vector));
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniform3fv(program_id, uniformsLocations[uniform_name], 1, glm::value_ptr(vector));
-        }
+        glProgramUniform3fv(program_id, uniform_location(uniform_name), 1, glm::value_ptr(vector));
+    }
+
+    auto Shader::setUniform3iv(const std::string &uniform_name, const glm::ivec3 &vector) -> void
+    {
+        glProgramUniform3iv(program_id, uniform_location(uniform_name), 1, glm::value_ptr(vector));
     }
 
     auto Shader::setUniform4fv(const std::string &uniform_name, const glm::vec4 &vector) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniform4fv(program_id, uniformsLocations[uniform_name], 1, glm::value_ptr(vector));
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniform4fv(program_id, uniformsLocations[uniform_name], 1, glm::value_ptr(vector));
-        }
+        glProgramUniform4fv(program_id, uniform_location(uniform_name), 1, glm::value_ptr(vector));
     }
 
     auto Shader::setUniformMatrix3fv(const std::string &uniform_name, const glm::mat3 &matrix) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniformMatrix3fv(program_id, uniformsLocations[uniform_name], 1, GL_FALSE, glm::value_ptr(matrix));
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniformMatrix3fv(program_id, uniformsLocations[uniform_name], 1, GL_FALSE, glm::value_ptr(matrix));
-        }
+        glProgramUniformMatrix3fv(program_id, uniform_location(uniform_name), 1, GL_FALSE, glm::value_ptr(matrix));
     }
 
     auto Shader::setUniformMatrix4fv(const std::string &uniform_name, const glm::mat4 &matrix) -> void
     {
-        if (uniformsLocations.count(uniform_name))
-        {
-            glProgramUniformMatrix4fv(program_id, uniformsLocations[uniform_name], 1, GL_FALSE, glm::value_ptr(matrix));
-        }
-        else if (getUniformLocation(uniform_name))
-        {
-            glProgramUniformMatrix4fv(program_id, uniformsLocations[uniform_name], 1, GL_FALSE, glm::value_ptr(matrix));
-        }
+        glProgramUniformMatrix4fv(program_id, uniform_location(uniform_name), 1, GL_FALSE, glm::value_ptr(matrix));
     }
 
     // auto Shader::createUniformBuffer(const std::string &uniform_name, const std::vector<glm::vec2>& buffer) -> GLuint
@@ -244,19 +176,42 @@ namespace render
     //     glBindBufferBase(GL_UNIFORM_BUFFER, 0, ubo);
     // }
 
-    auto Shader::getUniformLocation(const std::string &uniform_name) -> bool
+    auto Shader::uniform_location(const std::string &uniform_name) -> GLint
     {
-        GLint uniform_location = glGetUniformLocation(program_id, uniform_name.c_str());
+        auto location = uniformsLocations.find(uniform_name);
+        if (location != uniformsLocations.end())
+            return location->second;
+
+        // remembered as -1, so the miss is reported once and later sets are dropped by GL
+        fprintf(stderr, "Error! Can't find uniform %s\n", uniform_name.c_str());
+        uniformsLocations.emplace(uniform_name, -1);
+        return -1;
+    }
 
-        if (uniform_location != -1)
-        {
-            uniformsLocations[uniform_name] = uniform_location;
-            return true;
-        }
-        else
-        {
-            fprintf(stderr, "Error! Can't find uniform %s\n", uniform_name.c_str());
-            return false;
+    auto Shader::load_uniform_locations() -> void
+    {
+        uniformsLocations.clear();
+
+        auto uniform_num{0};
+        auto max_name_length{0};
+        glGetProgramiv(program_id, GL_ACTIVE_UNIFORMS, &uniform_num);
+        glGetProgramiv(program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+        auto name = std::string(max_name_length, '\0');
+        for (auto i = 0; i < uniform_num; i++) {
+            auto length{0};
+            auto size{0};
+            auto type = GLenum{};
+            glGetActiveUniform(program_id, i, max_name_length, &length, &size, &type, name.data());
+            auto uniform_name = name.substr(0, length);
+            // uniforms in blocks have no location
+            auto location = glGetUniformLocation(program_id, uniform_name.c_str());
+            if (location == -1)
+                continue;
+            uniformsLocations[uniform_name] = location;
+            // arrays are listed as "name[0]", they are set by "name" and count elements
+            if (uniform_name.ends_with("[0]"))
+                uniformsLocations[uniform_name.substr(0, uniform_name.size() - 3)] = location;
         }
     }
 
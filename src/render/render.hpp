@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <type_traits>
 #include <GL/glew.h>
 #include <glm/glm.hpp>
 #include <unordered_map>
@@ -18,14 +19,30 @@
 namespace render
 {
     using shader_stage_type = unsigned long;
+
+    // Location of one uniform, resolved once after link through Shader::uniform. Setting through a
+    // handle is a single glProgramUniform call, no name hashing and no allocation.
+    template <typename T>
+    struct Uniform_Handle final
+    {
+        GLint location{-1};
+    };
+
     struct Shader final
     {
         std::unordered_map<shader_stage_type, std::string> shader_stage_type_to_path{};
+        // every active uniform, filled when the program links
         std::unordered_map<std::string, GLint> uniformsLocations{};
         GLuint program_id{};
 
         auto compile(const std::string& marco = "") -> bool;
 
+        auto release() -> void
+        {
+            glDeleteProgram(program_id);
+            program_id = 0;
+        }
+
         auto apply() -> bool
         {
             if (program_id != 0) {
@@ -44,6 +61,7 @@ namespace render
         auto setUniform1iv(const std::string &uniform_name, GLsizei count, int *value) -> void;
         auto setUniform2fv(const std::string &uniform_name, const glm::vec2 &vector) -> void;
         auto setUniform3fv(const std::string &uniform_name, const glm::vec3 &vector) -> void;
+        auto setUniform3iv(const std::string &uniform_name, const glm::ivec3 &vector) -> void;
         auto setUniform4fv(const std::string &uniform_name, const glm::vec4 &vector) -> void;
         auto setUniformMatrix3fv(const std::string &uniform_name, const glm::mat3 &matrix) -> void;
         auto setUniformMatrix4fv(const std::string &uniform_name, const glm::mat4 &matrix) -> void;
@@ -51,7 +69,56 @@ namespace render
         // auto createUniformBuffer(const std::string &uniform_name, const std::vector<glm::vec2>& buffer) -> GLuint;
         // auto setUniformBuffer(const std::string &uniform_name, const std::vector<glm::vec2>& buffer, GLuint ubo) -> void;
 
-        auto getUniformLocation(const std::string &uniform_name) -> bool;
+        // one lookup, a miss is reported the first time and gives -1, which GL ignores
+        auto uniform_location(const std::string &uniform_name) -> GLint;
+
+        // resolve handles right after compile, so a missing name shows up once, when the shader loads
+        template <typename T>
+        auto uniform(const std::string &uniform_name) -> Uniform_Handle<T>
+        {
+            return {uniform_location(uniform_name)};
+        }
+
+        template <typename T>
+        auto set(Uniform_Handle<T> handle, const T &value) const -> void
+        {
+            set(handle, &value, 1);
+        }
+
+        // count consecutive array elements starting at the handle's
+        template <typename T>
+        auto set(Uniform_Handle<T> handle, const T *values, GLsizei count) const -> void
+        {
+            if constexpr (std::is_same_v<T, bool>) {
+                // GL ignores -1 on its own, but -1 + i would be somebody else's location
+                if (handle.location == -1)
+                    return;
+                for (auto i = 0; i < count; i++)
+                    glProgramUniform1i(program_id, handle.location + i, values[i] ? 1 : 0);
+            } else if constexpr (std::is_same_v<T, int>) {
+                glProgramUniform1iv(program_id, handle.location, count, values);
+            } else if constexpr (std::is_same_v<T, unsigned int>) {
+                glProgramUniform1uiv(program_id, handle.location, count, values);
+            } else if constexpr (std::is_same_v<T, float>) {
+                glProgramUniform1fv(program_id, handle.location, count, values);
+            } else if constexpr (std::is_same_v<T, glm::vec2>) {
+                glProgramUniform2fv(program_id, handle.location, count, &values->x);
+            } else if constexpr (std::is_same_v<T, glm::vec3>) {
+                glProgramUniform3fv(program_id, handle.location, count, &values->x);
+            } else if constexpr (std::is_same_v<T, glm::ivec3>) {
+                glProgramUniform3iv(program_id, handle.location, count, &values->x);
+            } else if constexpr (std::is_same_v<T, glm::vec4>) {
+                glProgramUniform4fv(program_id, handle.location, count, &values->x);
+            } else if constexpr (std::is_same_v<T, glm::mat3>) {
+                glProgramUniformMatrix3fv(program_id, handle.location, count, GL_FALSE, &(*values)[0].x);
+            } else if constexpr (std::is_same_v<T, glm::mat4>) {
+                glProgramUniformMatrix4fv(program_id, handle.location, count, GL_FALSE, &(*values)[0].x);
+            } else {
+                static_assert(sizeof(T) == 0, "no glProgramUniform for this type");
+            }
+        }
+
+        auto load_uniform_locations() -> void;
     };
 
     namespace window {
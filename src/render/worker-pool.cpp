@@ -0,0 +1,131 @@
+#include "worker-pool.hpp"
+
+#include <algorithm>
+
+namespace Parallel
+{
+    static auto pack(std::uint32_t begin, std::uint32_t end) -> std::uint64_t
+    {
+        return (std::uint64_t(begin) << 32) | end;
+    }
+
+    Worker_Pool::Worker_Pool(int thread_num)
+    {
+        worker_num = thread_num > 0 ? thread_num : std::max(1u, std::thread::hardware_concurrency());
+        queues = std::make_unique<Chunk_Queue[]>(worker_num);
+        for (auto i = 1; i < worker_num; i++) {
+            threads.emplace_back([this, i]() -> void { worker_loop(i); });
+        }
+    }
+
+    Worker_Pool::~Worker_Pool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stop = true;
+        }
+        start_cv.notify_all();
+        for (auto& thd: threads) {
+            if (thd.joinable())
+                thd.join();
+        }
+    }
+
+    auto Worker_Pool::shared() -> Worker_Pool&
+    {
+        static Worker_Pool pool{};
+        return pool;
+    }
+
+    auto Worker_Pool::parallel_for(int count, int align, const std::function<void(int begin, int end)>& fn) -> void
+    {
+        if (count <= 0)
+            return;
+
+        // a few chunks per worker leaves something to steal without making chunks tiny
+        align = std::max(align, 1);
+        auto chunk = std::max(align, (count / (worker_num * 8) + align - 1) / align * align);
+        auto chunk_num = (count + chunk - 1) / chunk;
+
+        if (worker_num == 1 || chunk_num == 1) {
+            fn(0, count);
+            return;
+        }
+
+        for (auto w = 0; w < worker_num; w++) {
+            auto begin = std::uint32_t(std::int64_t(chunk_num) * w / worker_num);
+            auto end = std::uint32_t(std::int64_t(chunk_num) * (w + 1) / worker_num);
+            queues[w].range.store(pack(begin, end), std::memory_order_relaxed);
+        }
+        job = &fn;
+        job_count = count;
+        job_chunk = chunk;
+        busy.store(worker_num - 1);
+        {
+            std::lock_guard lock(mutex);
+            generation++;
+        }
+        start_cv.notify_all();
+
+        run_chunks(0);
+
+        std::unique_lock lock(mutex);
+        done_cv.wait(lock, [&]() -> bool { return busy.load() == 0; });
+    }
+
+    auto Worker_Pool::worker_loop(int worker_id) -> void
+    {
+        auto seen_generation = std::uint64_t{};
+        while (true) {
+            {
+                std::unique_lock lock(mutex);
+                start_cv.wait(lock, [&]() -> bool { return stop || generation != seen_generation; });
+                if (stop)
+                    return;
+                seen_generation = generation;
+            }
+
+            run_chunks(worker_id);
+
+            if (busy.fetch_sub(1) == 1) {
+                std::lock_guard lock(mutex);
+                done_cv.notify_one();
+            }
+        }
+    }
+
+    auto Worker_Pool::run_chunks(int worker_id) -> void
+    {
+        auto run = [&](std::uint32_t c) -> void {
+            auto begin = int(c) * job_chunk;
+            (*job)(begin, std::min(job_count, begin + job_chunk));
+        };
+
+        auto pop = [&](Chunk_Queue& queue, bool front, std::uint32_t& c) -> bool {
+            auto range = queue.range.load();
+            while (true) {
+                auto begin = std::uint32_t(range >> 32);
+                auto end = std::uint32_t(range);
+                if (begin >= end)
+                    return false;
+                auto next = front ? pack(begin + 1, end) : pack(begin, end - 1);
+                if (queue.range.compare_exchange_weak(range, next)) {
+                    c = front ? begin : end - 1;
+                    return true;
+                }
+            }
+        };
+
+        auto c = std::uint32_t{};
+        while (pop(queues[worker_id], true, c)) {
+            run(c);
+        }
+        // own run is done, steal from the back of the others
+        for (auto k = 1; k < worker_num; k++) {
+            auto& victim = queues[(worker_id + k) % worker_num];
+            while (pop(victim, false, c)) {
+                run(c);
+            }
+        }
+    }
+} // namespace Parallel
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace Parallel
+{
+    constexpr std::size_t cache_line_size = 64;
+
+    // smallest item count whose byte size is a whole number of cache lines
+    template <typename T>
+    constexpr auto cache_line_items() -> int
+    {
+        return int(cache_line_size / std::gcd(sizeof(T), cache_line_size));
+    }
+
+    // keeps array storage cache line aligned, so chunks of cache_line_items<T>() never share a line
+    template <typename T>
+    struct Cache_Aligned_Allocator
+    {
+        using value_type = T;
+
+        Cache_Aligned_Allocator() = default;
+
+        template <typename U>
+        Cache_Aligned_Allocator(const Cache_Aligned_Allocator<U>&) {}
+
+        auto allocate(std::size_t n) -> T*
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(cache_line_size)));
+        }
+
+        auto deallocate(T* p, std::size_t) -> void
+        {
+            ::operator delete(p, std::align_val_t(cache_line_size));
+        }
+
+        template <typename U>
+        auto operator == (const Cache_Aligned_Allocator<U>&) const -> bool
+        {
+            return true;
+        }
+    };
+
+    // Persistent threads sized from hardware_concurrency, the calling thread works as worker 0.
+    // parallel_for cuts [0, count) into contiguous chunks aligned to `align` items and gives every
+    // worker its own contiguous run of chunks; a worker that runs dry steals from the back of the others.
+    // Not reentrant: fn must not call parallel_for on the same pool.
+    struct Worker_Pool final
+    {
+        explicit Worker_Pool(int thread_num = 0);
+
+        ~Worker_Pool();
+
+        Worker_Pool(const Worker_Pool&) = delete;
+        auto operator = (const Worker_Pool&) -> Worker_Pool& = delete;
+
+        auto thread_num() const -> int
+        {
+            return worker_num;
+        }
+
+        auto parallel_for(int count, int align, const std::function<void(int begin, int end)>& fn) -> void;
+
+        static auto shared() -> Worker_Pool&;
+
+    private:
+        // packed [begin, end) chunk range, owner pops the front, thieves pop the back
+        struct alignas(cache_line_size) Chunk_Queue final
+        {
+            std::atomic<std::uint64_t> range{};
+        };
+
+        auto worker_loop(int worker_id) -> void;
+
+        auto run_chunks(int worker_id) -> void;
+
+        int worker_num{1};
+        std::unique_ptr<Chunk_Queue[]> queues{};
+        std::vector<std::thread> threads{};
+
+        std::mutex mutex{};
+        std::condition_variable start_cv{};
+        std::condition_variable done_cv{};
+        std::uint64_t generation{};
+        std::atomic<int> busy{};
+        bool stop{false};
+
+        const std::function<void(int, int)>* job{nullptr};
+        int job_count{};
+        int job_chunk{};
+    };
+} // namespace Parallel